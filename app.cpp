@@ -1,16 +1,97 @@
 #include "app.hpp"
 
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
 #include <stdexcept>
+#include <unordered_map>
 
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <csvpp/csv.hpp>
 
-std::vector<App> read_app_list(const std::string & app_list_path)
+#include "file.hpp"
+
+namespace
+{
+    // Compiled catalog layout, in native byte order:
+    //   Catalog_header
+    //   Catalog_entry[num_apps], at entries_offset
+    //   string table of NUL terminated strings, referenced by offset from the start of the file
+    // magic, version and source are kept where they are by later versions, so an outdated catalog can still find its CSV
+    constexpr char catalog_magic[8] = {'F', 'B', 'L', 'C', 'A', 'T', '\0', '\0'};
+    constexpr std::uint32_t catalog_version = 1;
+
+    struct Catalog_string
+    {
+        std::uint32_t offset;
+        std::uint32_t size; // not including the NUL
+    };
+
+    struct Catalog_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        Catalog_string source; // absolute path of the CSV this was compiled from
+        std::uint32_t reserved; // 0. Explicit, so that no padding of indeterminate value is written
+        std::int64_t source_mtime_sec;
+        std::int64_t source_mtime_nsec;
+        std::uint64_t source_size;
+        std::uint32_t num_apps;
+        std::uint32_t entries_offset;
+    };
+
+    enum Input_flags: std::uint8_t
+    {
+        INPUT_CEC      = 1 << 0,
+        INPUT_KEYBOARD = 1 << 1,
+        INPUT_MOUSE    = 1 << 2,
+        INPUT_GAMEPAD  = 1 << 3,
+    };
+
+    struct Catalog_entry
+    {
+        Catalog_string title;
+        Catalog_string desc;
+        Catalog_string command;
+        Catalog_string thumbnail_path; // empty if it wasn't readable at compile time
+        Catalog_string note;
+        std::uint8_t inputs; // Input_flags
+        std::uint8_t padding[3];
+    };
+
+    // the on-disk layout, with no padding left for the compiler to add
+    static_assert(sizeof(Catalog_string) == 8);
+    static_assert(offsetof(Catalog_header, version) == 8);
+    static_assert(offsetof(Catalog_header, source) == 12);
+    static_assert(offsetof(Catalog_header, reserved) == 20);
+    static_assert(offsetof(Catalog_header, source_mtime_sec) == 24);
+    static_assert(offsetof(Catalog_header, num_apps) == 48);
+    static_assert(offsetof(Catalog_header, entries_offset) == 52);
+    static_assert(sizeof(Catalog_header) == 56);
+    static_assert(offsetof(Catalog_entry, inputs) == 40);
+    static_assert(sizeof(Catalog_entry) == 44);
+
+    bool same_source(const struct stat & st, const Catalog_header & header)
+    {
+        return st.st_mtim.tv_sec == header.source_mtime_sec && st.st_mtim.tv_nsec == header.source_mtime_nsec
+            && static_cast<std::uint64_t>(st.st_size) == header.source_size;
+    }
+}
+
+App_list App_list::read_csv(const std::string & csv_path)
 {
-    auto apps = std::vector<App>{};
+    auto list = App_list{};
 
-    auto reader = csv::Reader{app_list_path};
+    auto reader = csv::Reader{csv_path};
     for(auto && row: reader)
     {
         using std::string;
@@ -24,22 +105,174 @@ std::vector<App> read_app_list(const std::string & app_list_path)
         if(access(thumbnail_path.c_str(), F_OK) != 0 || access(thumbnail_path.c_str(), R_OK) != 0)
             thumbnail_path.clear();
 
-        apps.emplace_back(App
+        auto & strings = list.strings_;
+        list.apps_.emplace_back(App
         {
-            .title          = std::get<0>(row_t),
-            .desc           = std::get<1>(row_t),
-            .command        = std::get<2>(row_t).empty() ? std::string{"/dev/false"} : std::get<2>(row_t),
-            .thumbnail_path = std::move(thumbnail_path),
+            .title          = strings.emplace_back(std::move(std::get<0>(row_t))),
+            .desc           = strings.emplace_back(std::move(std::get<1>(row_t))),
+            .command        = strings.emplace_back(std::get<2>(row_t).empty() ? std::string{"/dev/false"} : std::move(std::get<2>(row_t))),
+            .thumbnail_path = strings.emplace_back(std::move(thumbnail_path)),
             .input_cec      = std::get<4>(row_t) == 0 ? false : true,
             .input_keyboard = std::get<5>(row_t) == 0 ? false : true,
             .input_mouse    = std::get<6>(row_t) == 0 ? false : true,
             .input_gamepad  = std::get<7>(row_t) == 0 ? false : true,
-            .note           = std::get<8>(row_t)
+            .note           = strings.emplace_back(std::move(std::get<8>(row_t)))
         });
     }
 
-    if(apps.empty())
+    if(list.apps_.empty())
         throw std::runtime_error{"Error reading app CSV file: no apps listed"};
 
-    return apps;
+    list.path_ = csv_path;
+    list.sources_ = {csv_path};
+
+    return list;
+}
+
+App_list read_app_list(const std::string & app_list_path)
+{
+    // check the magic with a read. A CSV is the user's to edit in place, which would SIGBUS a mapping. Only a catalog,
+    // which compile_app_list replaces by rename, is mapped
+    char magic[sizeof(catalog_magic)] {};
+    if(File{app_list_path}.read_at(0, magic, sizeof(magic)) < sizeof(magic) || std::memcmp(magic, catalog_magic, sizeof(catalog_magic)) != 0)
+        return App_list::read_csv(app_list_path);
+
+    auto mapping = Mmap{app_list_path};
+    auto data = mapping.data();
+    auto size = mapping.size();
+
+    if(size < sizeof(catalog_magic) || std::memcmp(data, catalog_magic, sizeof(catalog_magic)) != 0) // replaced since
+        return App_list::read_csv(app_list_path);
+
+    auto header = Catalog_header{};
+    if(size < sizeof(header))
+        throw std::runtime_error{"Error reading app catalog " + app_list_path + ": truncated"};
+    std::memcpy(&header, data, sizeof(header));
+
+    auto get_string = [&](const Catalog_string & str)
+    {
+        if(str.offset >= size || str.size >= size - str.offset || data[str.offset + str.size] != '\0')
+            throw std::runtime_error{"Error reading app catalog " + app_list_path + ": corrupt string table"};
+        return std::string_view{reinterpret_cast<const char *>(data) + str.offset, str.size};
+    };
+
+    // prefer the CSV if the catalog doesn't match it any more. If the CSV is gone, the catalog is all there is
+    auto source = std::string{get_string(header.source)};
+    struct stat st;
+    if(stat(source.c_str(), &st) == 0 && (header.version != catalog_version || !same_source(st, header)))
+    {
+        std::cerr<<"App catalog "<<app_list_path<<" is out of date with "<<source<<", reading the CSV instead\n";
+        auto list = App_list::read_csv(source);
+        list.path_ = app_list_path;
+        list.sources_ = {app_list_path, source};
+        return list;
+    }
+    if(header.version != catalog_version)
+        throw std::runtime_error{"Error reading app catalog " + app_list_path + ": unsupported version " + std::to_string(header.version)};
+
+    if(header.entries_offset > size || (size - header.entries_offset) / sizeof(Catalog_entry) < header.num_apps)
+        throw std::runtime_error{"Error reading app catalog " + app_list_path + ": truncated"};
+
+    auto list = App_list{};
+    list.apps_.reserve(header.num_apps);
+    for(auto i = std::size_t{0}; i < header.num_apps; ++i)
+    {
+        auto entry = Catalog_entry{};
+        std::memcpy(&entry, data + header.entries_offset + i * sizeof(entry), sizeof(entry));
+
+        list.apps_.emplace_back(App
+        {
+            .title          = get_string(entry.title),
+            .desc           = get_string(entry.desc),
+            .command        = get_string(entry.command),
+            .thumbnail_path = get_string(entry.thumbnail_path),
+            .input_cec      = (entry.inputs & INPUT_CEC) != 0,
+            .input_keyboard = (entry.inputs & INPUT_KEYBOARD) != 0,
+            .input_mouse    = (entry.inputs & INPUT_MOUSE) != 0,
+            .input_gamepad  = (entry.inputs & INPUT_GAMEPAD) != 0,
+            .note           = get_string(entry.note)
+        });
+    }
+
+    if(list.apps_.empty())
+        throw std::runtime_error{"Error reading app catalog " + app_list_path + ": no apps listed"};
+
+    list.path_ = app_list_path;
+    list.sources_ = {app_list_path, source};
+    list.mapping_ = std::move(mapping);
+    return list;
+}
+
+void compile_app_list(const std::string & csv_path, const std::string & catalog_path)
+{
+    auto list = App_list::read_csv(csv_path);
+
+    struct stat st;
+    if(stat(csv_path.c_str(), &st) < 0)
+        throw std::runtime_error{"Error reading app CSV file: " + csv_path + " - " + std::strerror(errno)};
+
+    const auto & apps = list.get_apps();
+    auto header = Catalog_header{};
+    std::memcpy(header.magic, catalog_magic, sizeof(catalog_magic));
+    header.version = catalog_version;
+    header.reserved = 0;
+    header.source_mtime_sec = st.st_mtim.tv_sec;
+    header.source_mtime_nsec = st.st_mtim.tv_nsec;
+    header.source_size = static_cast<std::uint64_t>(st.st_size);
+    header.num_apps = static_cast<std::uint32_t>(std::size(apps));
+    header.entries_offset = sizeof(Catalog_header);
+
+    // identical strings (empty notes, shared commands, etc.) are stored once
+    const auto strings_offset = sizeof(Catalog_header) + std::size(apps) * sizeof(Catalog_entry);
+    auto strings = std::string{};
+    auto string_offsets = std::unordered_map<std::string_view, Catalog_string>{};
+    auto add_string = [&](std::string_view str)
+    {
+        if(auto found = string_offsets.find(str); found != std::end(string_offsets))
+            return found->second;
+
+        if(strings_offset + std::size(strings) + std::size(str) + 1 > std::numeric_limits<std::uint32_t>::max())
+            throw std::runtime_error{"Error compiling app catalog: too large"};
+
+        auto ref = Catalog_string{static_cast<std::uint32_t>(strings_offset + std::size(strings)), static_cast<std::uint32_t>(std::size(str))};
+        strings.append(str);
+        strings.push_back('\0');
+        string_offsets.emplace(str, ref);
+        return ref;
+    };
+
+    const auto source = std::filesystem::absolute(csv_path).string();
+    header.source = add_string(source);
+
+    auto entries = std::vector<Catalog_entry>{};
+    entries.reserve(std::size(apps));
+    for(auto & app: apps)
+    {
+        entries.push_back(Catalog_entry
+        {
+            .title          = add_string(app.title),
+            .desc           = add_string(app.desc),
+            .command        = add_string(app.command),
+            .thumbnail_path = add_string(app.thumbnail_path),
+            .note           = add_string(app.note),
+            .inputs         = static_cast<std::uint8_t>((app.input_cec      ? INPUT_CEC      : 0)
+                                                      | (app.input_keyboard ? INPUT_KEYBOARD : 0)
+                                                      | (app.input_mouse    ? INPUT_MOUSE    : 0)
+                                                      | (app.input_gamepad  ? INPUT_GAMEPAD  : 0)),
+            .padding        = {}
+        });
+    }
+
+    // write then rename, so a launcher starting meanwhile never sees a partial catalog
+    auto tmp_path = catalog_path + ".tmp";
+    {
+        auto out = std::ofstream{tmp_path, std::ios::binary};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(std::data(entries)), static_cast<std::streamsize>(std::size(entries) * sizeof(Catalog_entry)));
+        out.write(std::data(strings), static_cast<std::streamsize>(std::size(strings)));
+        if(!out)
+            throw std::runtime_error{"Error writing app catalog: " + tmp_path};
+    }
+    if(std::rename(tmp_path.c_str(), catalog_path.c_str()) < 0)
+        throw std::runtime_error{"Error writing app catalog: " + catalog_path + " - " + std::strerror(errno)};
 }
@@ -1,22 +1,66 @@
 #ifndef APP_HPP
 #define APP_HPP
 
+#include <deque>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "mmap.hpp"
+
+// Strings point into the App_list that loaded them, and are always NUL terminated
 struct App
 {
-    std::string title;
-    std::string desc;
-    std::string command;
-    std::string thumbnail_path;
+    std::string_view title;
+    std::string_view desc;
+    std::string_view command;
+    std::string_view thumbnail_path;
     bool input_cec;
     bool input_keyboard;
     bool input_mouse;
     bool input_gamepad;
-    std::string note;
+    std::string_view note;
+
+    bool operator==(const App &) const = default;
 };
 
-std::vector <App> read_app_list(const std::string & app_list_path);
+// The apps to display, and the storage their strings live in: either a mapped compiled catalog, or strings parsed from CSV
+class App_list
+{
+public:
+    App_list() = default;
+
+    App_list(const App_list &) = delete;
+    App_list &operator=(const App_list &) = delete;
+    App_list(App_list &&) = default;
+    App_list &operator=(App_list &&) = default;
+
+    const std::vector<App> & get_apps() const { return apps_; }
+
+    // the path this was read from, and every file it depends on (the path itself, plus a catalog's CSV)
+    const std::string & get_path() const { return path_; }
+    const std::vector<std::string> & get_sources() const { return sources_; }
+
+private:
+    friend App_list read_app_list(const std::string & app_list_path);
+    friend void compile_app_list(const std::string & csv_path, const std::string & catalog_path);
+
+    static App_list read_csv(const std::string & csv_path);
+
+    std::string path_;
+    std::vector<std::string> sources_;
+
+    Mmap mapping_;
+    std::deque<std::string> strings_; // deque so growing it doesn't move the strings apps_ points to
+    std::vector<App> apps_;
+};
+
+// Read either a CSV app list or a catalog made by compile_app_list. If a catalog's source CSV has changed since it was
+// compiled, the CSV is read instead
+App_list read_app_list(const std::string & app_list_path);
+
+// Compile a CSV app list into a binary catalog that can be loaded without parsing. Disabled apps are left out and
+// unreadable thumbnails are dropped ahead of time
+void compile_app_list(const std::string & csv_path, const std::string & catalog_path);
 
 #endif // APP_HPP
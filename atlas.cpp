@@ -0,0 +1,227 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+
+namespace SDL
+{
+    std::optional<Atlas_region> Atlas::add(Renderer & renderer, const Image & image)
+    {
+        if(page_size_ == 0)
+        {
+            page_size_ = default_page_size;
+
+            SDL_RendererInfo info;
+            if(SDL_GetRendererInfo(renderer, &info) == 0)
+            {
+                if(info.max_texture_width > 0)
+                    page_size_ = std::min(page_size_, info.max_texture_width);
+                if(info.max_texture_height > 0)
+                    page_size_ = std::min(page_size_, info.max_texture_height);
+            }
+
+            // a smaller page still packs the small stuff, which is most of what's drawn
+            while(max_bytes_ > 0 && page_bytes() > max_bytes_ && page_size_ / 2 >= min_page_size)
+                page_size_ /= 2;
+        }
+
+        if(image.empty() || !fits(image))
+            return std::nullopt;
+
+        const auto scale_mode = use_nearest_filtering(image.width, image.height) ? SDL_ScaleModeNearest : SDL_ScaleModeLinear;
+        for(auto page = 0; ; ++page)
+        {
+            if(page == used_pages_)
+            {
+                if(used_pages_ >= page_limit())
+                    return std::nullopt;
+                if(used_pages_ == static_cast<int>(std::size(pages_)))
+                    add_page(renderer);
+                ++used_pages_;
+
+                // a page kept from before a clear() may have been filtered the other way
+                if(pages_[page].scale_mode != scale_mode)
+                {
+                    SDL_SetTextureScaleMode(pages_[page].texture, scale_mode);
+                    pages_[page].scale_mode = scale_mode;
+                }
+            }
+            else if(pages_[page].scale_mode != scale_mode)
+                continue;
+
+            if(auto rect = allocate(pages_[page], image.width, image.height); rect)
+            {
+                if(SDL_UpdateTexture(pages_[page].texture, &*rect, image.data(), 4 * image.width) < 0)
+                    sdl_error("Unable to load SDL texture");
+
+                return Atlas_region{page, *rect, generation_};
+            }
+        }
+    }
+
+    void Atlas::account(Texture_memory & memory, std::size_t max_bytes)
+    {
+        memory_ = &memory;
+        max_bytes_ = max_bytes;
+    }
+
+    int Atlas::page_limit() const
+    {
+        if(max_bytes_ == 0)
+            return max_pages_;
+        return std::min(max_pages_, static_cast<int>(max_bytes_ / page_bytes()));
+    }
+
+    bool Atlas::fits(const Image & image) const
+    {
+        // budget too small for even one page
+        if(page_size_ && page_limit() == 0)
+            return false;
+
+        auto size = page_size_ ? page_size_ : default_page_size;
+        return image.width + padding <= size && image.height + padding <= size;
+    }
+
+    void Atlas::clear()
+    {
+        ++generation_;
+        used_pages_ = 0;
+        for(auto & page: pages_)
+        {
+            page.shelves.clear();
+            page.next_y = 0;
+        }
+    }
+
+    void Atlas::release()
+    {
+        clear();
+        for(auto & page: pages_)
+        {
+            if(page.texture)
+                SDL_DestroyTexture(page.texture);
+        }
+        pages_.clear();
+        page_size_ = 0;
+    }
+
+    std::optional<SDL_Rect> Atlas::allocate(Page & page, int w, int h)
+    {
+        const auto padded_w = w + padding;
+        const auto padded_h = h + padding;
+
+        // best fitting shelf with room left, not wasting more than half its height
+        Shelf * best = nullptr;
+        for(auto & shelf: page.shelves)
+        {
+            if(shelf.height >= padded_h && shelf.height <= 2 * padded_h && shelf.x + padded_w <= page_size_
+                    && (!best || shelf.height < best->height))
+            {
+                best = &shelf;
+            }
+        }
+
+        if(!best)
+        {
+            if(page.next_y + padded_h > page_size_)
+                return std::nullopt;
+
+            page.shelves.emplace_back(Shelf{page.next_y, padded_h, 0});
+            page.next_y += padded_h;
+            best = &page.shelves.back();
+        }
+
+        auto rect = SDL_Rect{best->x, best->y, w, h};
+        best->x += padded_w;
+        return rect;
+    }
+
+    void Atlas::add_page(Renderer & renderer)
+    {
+        auto texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, page_size_, page_size_);
+        if(!texture)
+            sdl_error("Unable to create SDL texture");
+
+        // the padding between regions has to be transparent, or it will bleed in when filtering
+        auto blank = std::vector<unsigned char>(page_size_ * page_size_ * 4, 0);
+        if(SDL_UpdateTexture(texture, nullptr, std::data(blank), 4 * page_size_) < 0)
+        {
+            SDL_DestroyTexture(texture);
+            sdl_error("Unable to load SDL texture");
+        }
+
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
+
+        pages_.emplace_back(Page{texture, {}, 0, SDL_ScaleModeLinear, {}});
+        if(memory_)
+            pages_.back().charge = memory_->charge(Texture_memory::Category::ATLAS, page_bytes());
+    }
+
+    void Batch::add(SDL_Texture * texture, const SDL_Rect & src, int tex_w, int tex_h, const SDL_Rect & dest, SDL_Color color)
+    {
+        auto & g = group(texture);
+        auto base = static_cast<int>(std::size(g.vertices));
+
+        const auto u0 = static_cast<float>(src.x) / tex_w;
+        const auto v0 = static_cast<float>(src.y) / tex_h;
+        const auto u1 = static_cast<float>(src.x + src.w) / tex_w;
+        const auto v1 = static_cast<float>(src.y + src.h) / tex_h;
+
+        const auto x0 = static_cast<float>(dest.x);
+        const auto y0 = static_cast<float>(dest.y);
+        const auto x1 = static_cast<float>(dest.x + dest.w);
+        const auto y1 = static_cast<float>(dest.y + dest.h);
+
+        g.vertices.push_back(SDL_Vertex{{x0, y0}, color, {u0, v0}});
+        g.vertices.push_back(SDL_Vertex{{x1, y0}, color, {u1, v0}});
+        g.vertices.push_back(SDL_Vertex{{x1, y1}, color, {u1, v1}});
+        g.vertices.push_back(SDL_Vertex{{x0, y1}, color, {u0, v1}});
+
+        for(auto i: {0, 1, 2, 0, 2, 3})
+            g.indices.push_back(base + i);
+    }
+
+    void Batch::add_fill(const SDL_Rect & dest, SDL_Color color)
+    {
+        add(nullptr, SDL_Rect{0, 0, 1, 1}, 1, 1, dest, color);
+    }
+
+    void Batch::draw(Renderer & renderer)
+    {
+        for(auto i = 0u; i < used_groups_; ++i)
+        {
+            auto & g = groups_[i];
+            if(!std::empty(g.indices))
+            {
+                SDL_RenderGeometry(renderer, g.texture, std::data(g.vertices), static_cast<int>(std::size(g.vertices)),
+                        std::data(g.indices), static_cast<int>(std::size(g.indices)));
+            }
+        }
+    }
+
+    void Batch::clear()
+    {
+        for(auto i = 0u; i < used_groups_; ++i)
+        {
+            groups_[i].vertices.clear();
+            groups_[i].indices.clear();
+        }
+        used_groups_ = 0;
+    }
+
+    Batch::Group & Batch::group(SDL_Texture * texture)
+    {
+        for(auto i = 0u; i < used_groups_; ++i)
+        {
+            if(groups_[i].texture == texture)
+                return groups_[i];
+        }
+
+        if(used_groups_ == std::size(groups_))
+            groups_.emplace_back();
+
+        auto & g = groups_[used_groups_++];
+        g.texture = texture;
+        return g;
+    }
+}
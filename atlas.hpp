@@ -0,0 +1,116 @@
+#ifndef ATLAS_HPP
+#define ATLAS_HPP
+
+#include <optional>
+#include <vector>
+
+#include "image.hpp"
+#include "sdl.hpp"
+#include "texture_memory.hpp"
+
+namespace SDL
+{
+    struct Atlas_region
+    {
+        int page {-1};
+        SDL_Rect rect {};
+        unsigned int generation {0};
+    };
+
+    // Packs many small images into a few large textures, using simple shelf packing. Regions are never freed
+    // individually; when the atlas fills up, clear() it and add back whatever is still needed.
+    // Each page is filtered one way, so images that use_nearest_filtering go on pages of their own
+    class Atlas
+    {
+    public:
+        explicit Atlas(int max_pages = 4): max_pages_{max_pages} {}
+        ~Atlas() { release(); }
+
+        Atlas(const Atlas &) = delete;
+        Atlas &operator=(const Atlas &) = delete;
+
+        // copy image into the atlas. Returns nullopt if there is no room left
+        std::optional<Atlas_region> add(Renderer & renderer, const Image & image);
+
+        // Charge pages to memory as they're created, and keep them within max_bytes in total (0 for no limit) by using
+        // fewer, and if need be smaller, pages. Call before anything is added
+        void account(Texture_memory & memory, std::size_t max_bytes = 0);
+
+        // whether image could fit at all, even in an empty atlas
+        bool fits(const Image & image) const;
+        // whether region is still valid (ie. hasn't been cleared since it was added)
+        bool contains(const Atlas_region & region) const
+        {
+            return region.generation == generation_ && region.page >= 0 && region.page < static_cast<int>(std::size(pages_));
+        }
+
+        // invalidate all regions, but keep the page textures for reuse
+        void clear();
+        // destroy the page textures. Must be called before the renderer is destroyed
+        void release();
+
+        SDL_Texture * get_page(int page) { return pages_[page].texture; }
+        int get_page_size() const { return page_size_; }
+
+    private:
+        struct Shelf
+        {
+            int y {0};
+            int height {0};
+            int x {0};
+        };
+        struct Page
+        {
+            SDL_Texture * texture {nullptr};
+            std::vector<Shelf> shelves;
+            int next_y {0};
+            SDL_ScaleMode scale_mode {SDL_ScaleModeLinear};
+            Texture_memory::Charge charge;
+        };
+
+        static constexpr int default_page_size = 2048;
+        static constexpr int min_page_size = 256;
+        static constexpr int padding = 1;
+
+        int max_pages_ {0};
+        int page_size_ {0};
+        Texture_memory * memory_ {nullptr};
+        std::size_t max_bytes_ {0};
+        unsigned int generation_ {1};
+        std::vector<Page> pages_;
+        int used_pages_ {0};
+
+        std::optional<SDL_Rect> allocate(Page & page, int w, int h);
+        void add_page(Renderer & renderer);
+        std::size_t page_bytes() const { return static_cast<std::size_t>(page_size_) * page_size_ * 4; }
+        int page_limit() const;
+    };
+
+    // Collects textured quads and draws them with one SDL_RenderGeometry call per texture, using vertex colors instead
+    // of per-texture color mods
+    class Batch
+    {
+    public:
+        // src is in pixels of texture, which is tex_w x tex_h
+        void add(SDL_Texture * texture, const SDL_Rect & src, int tex_w, int tex_h, const SDL_Rect & dest, SDL_Color color);
+        // untextured, solid color quad
+        void add_fill(const SDL_Rect & dest, SDL_Color color);
+
+        void draw(Renderer & renderer);
+        void clear();
+
+    private:
+        struct Group
+        {
+            SDL_Texture * texture {nullptr};
+            std::vector<SDL_Vertex> vertices;
+            std::vector<int> indices;
+        };
+        std::vector<Group> groups_;
+        std::size_t used_groups_ {0};
+
+        Group & group(SDL_Texture * texture);
+    };
+}
+
+#endif // ATLAS_HPP
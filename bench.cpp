@@ -0,0 +1,374 @@
+// Headless end-to-end benchmark
+// Generates a catalog of N apps with a mix of PNG and SVG thumbnails, runs the menu under SDL's offscreen video driver
+// with the software renderer, drives it through a fixed navigation / resize script, and prints the results as JSON
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+
+#include <sys/resource.h>
+
+#include <png.h>
+
+#include "app.hpp"
+#include "menu.hpp"
+
+namespace
+{
+    void usage()
+    {
+        std::cout<<"Usage: fb_launcher_bench [-n APPS] [-s STEPS] [-j THREADS] [-d DIR] [-f FILE] [-h]\n"
+                   "Benchmark the launcher without a display, and print the results as JSON\n"
+                   "\n"
+                   "Arguments\n"
+                   "  -n             Number of apps in the generated catalog (default: 200)\n"
+                   "  -s             Number of navigation steps between resizes (default: 50)\n"
+                   "  -j             Number of threads used to decode thumbnails (default: one per CPU core)\n"
+                   "  -d             Directory for the generated catalog, thumbnails, and thumbnail cache.\n"
+                   "                 Reusing a directory benchmarks with a warm cache (default: a new temp dir)\n"
+                   "  -f             Draw to FILE (created if needed) as if it were a framebuffer device, rather\n"
+                   "                 than through SDL's renderer. Resizes in the script have no effect\n"
+                   "  -h             Display this message and exit\n"
+                   "\n"
+                   "The video driver can be changed with SDL_VIDEODRIVER (default: offscreen)\n";
+    }
+
+    // a few sizes, including some that aren't square, to exercise scaling and letterboxing
+    constexpr int thumbnail_sizes[][2] = {{32, 32}, {64, 64}, {128, 128}, {256, 256}, {512, 512}, {1024, 1024}, {640, 360}, {200, 400}};
+
+    void write_png(const std::filesystem::path & path, int w, int h, int seed)
+    {
+        auto pixels = std::vector<png_byte>(static_cast<std::size_t>(w) * h * 4);
+        for(auto y = 0; y < h; ++y)
+        {
+            for(auto x = 0; x < w; ++x)
+            {
+                auto p = &pixels[(static_cast<std::size_t>(y) * w + x) * 4];
+                p[0] = static_cast<png_byte>(x * 255 / w);
+                p[1] = static_cast<png_byte>(y * 255 / h);
+                p[2] = static_cast<png_byte>(seed * 37);
+                p[3] = 0xFF;
+            }
+        }
+
+        png_image image {};
+        image.version = PNG_IMAGE_VERSION;
+        image.width = w;
+        image.height = h;
+        image.format = PNG_FORMAT_RGBA;
+
+        if(!png_image_write_to_file(&image, path.c_str(), 0, std::data(pixels), 0, nullptr))
+            throw std::runtime_error{"Could not write " + path.string() + ": " + image.message};
+    }
+
+    void write_svg(const std::filesystem::path & path, int w, int h, int seed)
+    {
+        auto out = std::ofstream{path};
+        out<<"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\""<<w<<"\" height=\""<<h<<"\" viewBox=\"0 0 "<<w<<' '<<h<<"\">"
+           <<"<rect width=\""<<w<<"\" height=\""<<h<<"\" rx=\""<<w / 8<<"\" fill=\"#"<<std::hex<<(0x204060 + seed * 0x0F0F0F) % 0xFFFFFF<<std::dec<<"\"/>"
+           <<"<circle cx=\""<<w / 2<<"\" cy=\""<<h / 2<<"\" r=\""<<std::min(w, h) / 3<<"\" fill=\"white\" fill-opacity=\"0.5\"/>"
+           <<"</svg>\n";
+        if(!out)
+            throw std::runtime_error{"Could not write " + path.string()};
+    }
+
+    struct Catalog
+    {
+        std::filesystem::path path;
+        int png {0};
+        int svg {0};
+        int none {0};
+    };
+
+    // Every 10th app has no thumbnail, and the rest alternate between PNG and SVG.
+    // Existing thumbnails are kept, so that a reused directory doesn't change the cache key
+    Catalog write_catalog(const std::filesystem::path & dir, int num_apps)
+    {
+        auto catalog = Catalog{dir / "catalog.csv"};
+        auto csv = std::ofstream{catalog.path};
+
+        for(auto i = 0; i < num_apps; ++i)
+        {
+            auto [w, h] = thumbnail_sizes[i % std::size(thumbnail_sizes)];
+
+            auto thumbnail = std::filesystem::path{};
+            if(i % 10 == 9)
+            {
+                ++catalog.none;
+            }
+            else if(i % 2 == 0)
+            {
+                thumbnail = dir / ("app" + std::to_string(i) + ".png");
+                if(!std::filesystem::exists(thumbnail))
+                    write_png(thumbnail, w, h, i);
+                ++catalog.png;
+            }
+            else
+            {
+                thumbnail = dir / ("app" + std::to_string(i) + ".svg");
+                if(!std::filesystem::exists(thumbnail))
+                    write_svg(thumbnail, w, h, i);
+                ++catalog.svg;
+            }
+
+            csv<<"App "<<i<<","
+               <<"Synthetic app number "<<i<<" with a description long enough to wrap onto another line at most sizes,"
+               <<"true,"
+               <<thumbnail.string()<<","
+               <<i % 2<<','<<(i / 2) % 2<<','<<(i / 4) % 2<<','<<(i / 8) % 2<<","
+               <<(i % 3 == 0 ? "1-4 players" : "")<<",1\n";
+        }
+
+        if(!csv)
+            throw std::runtime_error{"Could not write " + catalog.path.string()};
+
+        return catalog;
+    }
+
+    struct Step
+    {
+        enum class Type {RESIZE, PREV, NEXT, QUIT} type;
+        int w {0}, h {0};
+    };
+
+    // Start at the default size, then step forward and back through the list at a few more sizes
+    std::vector<Step> make_script(int steps)
+    {
+        auto script = std::vector<Step>{};
+        for(auto [w, h]: {std::pair{0, 0}, std::pair{1280, 720}, std::pair{1920, 1080}, std::pair{720, 480}})
+        {
+            script.push_back({Step::Type::RESIZE, w, h});
+            for(auto i = 0; i < steps; ++i)
+                script.push_back({i < steps * 3 / 4 ? Step::Type::NEXT : Step::Type::PREV});
+        }
+        script.push_back({Step::Type::QUIT});
+        return script;
+    }
+
+    void push_key(SDL_Keycode key)
+    {
+        SDL_Event ev;
+        SDL_zero(ev);
+        ev.type = SDL_KEYDOWN;
+        ev.key.state = SDL_PRESSED;
+        ev.key.keysym.sym = key;
+        SDL_PushEvent(&ev);
+    }
+
+    // size 0 x 0 just has the menu pick up whatever size the window already is
+    void push_resize(SDL_Window * window, int w, int h)
+    {
+        if(w > 0 && h > 0)
+        {
+            SDL_SetWindowFullscreen(window, 0);
+            SDL_SetWindowSize(window, w, h);
+        }
+
+        // Drivers don't all send this for a programmatic resize. A duplicate is harmless, as resize() ignores the same size
+        SDL_Event ev;
+        SDL_zero(ev);
+        ev.type = SDL_WINDOWEVENT;
+        ev.window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+        ev.window.windowID = SDL_GetWindowID(window);
+        SDL_PushEvent(&ev);
+    }
+
+    double to_ms(Frame_pacer::clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>{d}.count();
+    }
+
+    // count, mean, percentiles, and max of a set of durations, as a JSON object
+    void write_stats(std::ostream & os, std::vector<Frame_pacer::clock::duration> durations)
+    {
+        os<<"{\"count\": "<<std::size(durations);
+        if(!std::empty(durations))
+        {
+            std::sort(std::begin(durations), std::end(durations));
+
+            auto total = Frame_pacer::clock::duration{};
+            for(auto d: durations)
+                total += d;
+
+            auto percentile = [&durations](int p)
+            {
+                auto rank = (p * std::size(durations) + 99) / 100;
+                return to_ms(durations[std::max<std::size_t>(rank, 1) - 1]);
+            };
+
+            os<<", \"mean_ms\": "<<to_ms(total) / std::size(durations)
+              <<", \"p50_ms\": "<<percentile(50)
+              <<", \"p95_ms\": "<<percentile(95)
+              <<", \"p99_ms\": "<<percentile(99)
+              <<", \"max_ms\": "<<to_ms(durations.back());
+        }
+        os<<'}';
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    auto num_apps = 200;
+    auto steps = 50;
+    auto decode_threads = 0u;
+    auto dir = std::filesystem::path{};
+    auto fbdev = Fb_config{};
+
+    for(int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string{argv[i]};
+        if(arg == "-h")
+        {
+            usage();
+            return 0;
+        }
+        if((arg != "-n" && arg != "-s" && arg != "-j" && arg != "-d" && arg != "-f") || i + 1 >= argc)
+        {
+            usage();
+            std::cerr<<"\nUnknown argument or missing value: "<<arg<<'\n';
+            return 1;
+        }
+
+        auto value = std::string{argv[++i]};
+        try
+        {
+            if(arg == "-d")
+                dir = value;
+            else if(arg == "-f")
+            {
+                fbdev.path = value;
+                fbdev.create = true;
+            }
+            else if(auto n = std::stoi(value); n < 1)
+                throw std::out_of_range{arg};
+            else if(arg == "-n")
+                num_apps = n;
+            else if(arg == "-s")
+                steps = n;
+            else
+                decode_threads = static_cast<unsigned int>(n);
+        }
+        catch(const std::logic_error &)
+        {
+            usage();
+            std::cerr<<'\n'<<arg<<" requires a positive integer argument\n";
+            return 1;
+        }
+    }
+
+    try
+    {
+        auto remove_dir = dir.empty();
+        if(remove_dir)
+        {
+            auto temp_dir = (std::filesystem::temp_directory_path() / "fb_launcher_bench.XXXXXX").string();
+            if(!mkdtemp(std::data(temp_dir)))
+                throw std::runtime_error{"Could not create temp dir " + temp_dir};
+            dir = temp_dir;
+        }
+        else
+            std::filesystem::create_directories(dir);
+
+        // keep the thumbnail cache with the catalog, so that it is cold for a new dir, and warm for a reused one
+        setenv("XDG_CACHE_HOME", (dir / "cache").c_str(), 1);
+        setenv("SDL_VIDEODRIVER", "offscreen", 0);
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+        auto catalog = write_catalog(dir, num_apps);
+        auto app_list = read_app_list(catalog.path);
+        auto & apps = app_list.get_apps();
+
+        auto script = make_script(steps);
+        auto next_step = std::begin(script);
+
+        // the menu's own messages would get mixed up with the JSON
+        auto cout_buf = std::cout.rdbuf(std::clog.rdbuf());
+
+        auto timings = Menu::Timings{};
+        auto start = Frame_pacer::clock::now();
+
+        auto frames_rendered = std::uint64_t{0};
+        auto frames_skipped = std::uint64_t{0};
+        auto fb_bytes_written = std::uint64_t{0};
+        auto video_driver = std::string{};
+        {
+            auto menu = Menu{app_list, false, -1, {}, decode_threads, 8, false, 0, fbdev};
+            menu.record_timings(&timings);
+
+            menu.register_idle_callback([&next_step, end = std::end(script)](SDL_Window * window)
+            {
+                if(next_step == end)
+                    return;
+
+                switch(next_step->type)
+                {
+                    case Step::Type::RESIZE:
+                        push_resize(window, next_step->w, next_step->h);
+                        break;
+                    case Step::Type::PREV:
+                        push_key(SDLK_UP);
+                        break;
+                    case Step::Type::NEXT:
+                        push_key(SDLK_DOWN);
+                        break;
+                    case Step::Type::QUIT:
+                    {
+                        SDL_Event ev;
+                        SDL_zero(ev);
+                        ev.type = SDL_QUIT;
+                        SDL_PushEvent(&ev);
+                        break;
+                    }
+                }
+                ++next_step;
+            });
+
+            menu.run();
+
+            frames_rendered = menu.get_frames_rendered();
+            frames_skipped = menu.get_frames_skipped();
+            fb_bytes_written = menu.get_fb_bytes_written();
+            video_driver = SDL_GetCurrentVideoDriver();
+        }
+
+        std::cout.rdbuf(cout_buf);
+
+        rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+
+        std::cout<<"{\n"
+                 <<"  \"apps\": "<<std::size(apps)<<",\n"
+                 <<"  \"png_thumbnails\": "<<catalog.png<<",\n"
+                 <<"  \"svg_thumbnails\": "<<catalog.svg<<",\n"
+                 <<"  \"no_thumbnail\": "<<catalog.none<<",\n"
+                 <<"  \"video_driver\": \""<<video_driver<<"\",\n"
+                 <<"  \"time_to_first_frame_ms\": "<<(std::empty(timings.frames) ? -1.0 : to_ms(timings.first_present - start))<<",\n"
+                 <<"  \"time_to_fully_populated_ms\": "<<(timings.fully_populated == decltype(timings.fully_populated){} ? -1.0 : to_ms(timings.fully_populated - start))<<",\n"
+                 <<"  \"resize\": ";
+        write_stats(std::cout, timings.resizes);
+        std::cout<<",\n  \"frame\": ";
+        write_stats(std::cout, timings.frames);
+        std::cout<<",\n"
+                 <<"  \"frames_rendered\": "<<frames_rendered<<",\n"
+                 <<"  \"frames_skipped\": "<<frames_skipped<<",\n";
+        if(!fbdev.path.empty())
+            std::cout<<"  \"fb_bytes_written\": "<<fb_bytes_written<<",\n";
+        std::cout<<"  \"peak_rss_kb\": "<<usage.ru_maxrss<<"\n"
+                 <<"}\n";
+
+        if(remove_dir)
+            std::filesystem::remove_all(dir);
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        return 1;
+    }
+}
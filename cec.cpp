@@ -13,56 +13,97 @@ CEC_Input::CEC_Input()
     config_.callbackParam = this;
     callbacks_.keyPress = &CEC_Input::keypress;
 
-    adapter_ = CECInitialise(&config_);
-    if(!adapter_)
+    thread_ = std::thread{&CEC_Input::run, this};
+}
+
+CEC_Input::~CEC_Input()
+{
+    {
+        auto lock = std::scoped_lock{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void CEC_Input::register_callback(std::function<void(CEC::cec_user_control_code)> f)
+{
+    auto lock = std::scoped_lock{mutex_};
+    callback_ = std::move(f);
+}
+
+void CEC_Input::power_tv_on()
+{
+    {
+        auto lock = std::scoped_lock{mutex_};
+        power_on_requested_ = true;
+    }
+    cv_.notify_all();
+}
+
+void CEC_Input::run()
+{
+    open();
+
+    while(true)
+    {
+        {
+            auto lock = std::unique_lock{mutex_};
+            cv_.wait(lock, [this]{ return stopping_ || power_on_requested_; });
+            if(stopping_)
+                break;
+            power_on_requested_ = false;
+        }
+
+        if(adapter_)
+        {
+            adapter_->PowerOnDevices(CEC::CECDEVICE_TV);
+            adapter_->SetActiveSource();
+        }
+    }
+
+    if(adapter_)
+    {
+        adapter_->Close();
+        CECDestroy(adapter_);
+    }
+}
+
+void CEC_Input::open()
+{
+    auto adapter = CECInitialise(&config_);
+    if(!adapter)
     {
         std::cerr << "Failed to initialize libcec" << std::endl;
         return;
     }
 
     std::array<CEC::cec_adapter_descriptor,10> devices;
-    int8_t devices_found = adapter_->DetectAdapters(devices.data(), devices.size(), nullptr, true /*quickscan*/);
+    int8_t devices_found = adapter->DetectAdapters(devices.data(), devices.size(), nullptr, true /*quickscan*/);
     if(devices_found <= 0)
     {
         std::cerr << "Could not automatically determine the CEC adapter device\n";
-        CECDestroy(adapter_);
-        adapter_ = nullptr;
+        CECDestroy(adapter);
         return;
     }
 
     // Open a connection to the zeroth CEC device
-    if(!adapter_->Open(devices[0].strComName))
+    if(!adapter->Open(devices[0].strComName))
     {
         std::cerr << "Failed to open the CEC device on port " << devices[0].strComPath << std::endl;
-        CECDestroy(adapter_);
-        adapter_ = nullptr;
+        CECDestroy(adapter);
         return;
     }
     std::cout << "Opened the CEC device on port " << devices[0].strComPath << std::endl;
-}
 
-CEC_Input::~CEC_Input()
-{
-    if(adapter_)
-    {
-        adapter_->Close();
-        CECDestroy(adapter_);
-    }
+    adapter_ = adapter;
 }
 
 void CEC_Input::keypress(void * cbparam, const CEC::cec_keypress * key)
 {
     if(auto instance = static_cast<CEC_Input*>(cbparam); instance && key->duration == 0)
     {
+        auto lock = std::scoped_lock{instance->mutex_};
         instance->callback_(key->keycode);
     }
 }
-
-void CEC_Input::power_tv_on()
-{
-    if(adapter_)
-    {
-        adapter_->PowerOnDevices(CEC::CECDEVICE_TV);
-        adapter_->SetActiveSource();
-    }
-}
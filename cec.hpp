@@ -2,35 +2,48 @@
 #define CEC_HPP
 
 #include "cectypes.h"
+#include <condition_variable>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <thread>
 
 #include <libcec/cec.h>
 
+// The adapter is found, opened, and talked to from a background thread, since all of that can take seconds.
+// Remote input starts arriving as soon as it's ready
 class CEC_Input
 {
 private:
-    CEC::ICECAdapter * adapter_ {nullptr};
+    CEC::ICECAdapter * adapter_ {nullptr}; // only touched by the thread
     CEC::libcec_configuration config_ {};
     CEC::ICECCallbacks callbacks_ {};
 
     static void keypress(void * cbparam, const CEC::cec_keypress * key);
 
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ {false};
+    bool power_on_requested_ {false};
     std::function<void(CEC::cec_user_control_code)> callback_ = [](CEC::cec_user_control_code){};
 
+    std::thread thread_;
+
+    void run();
+    void open();
+
 public:
     CEC_Input();
     ~CEC_Input();
 
-    void register_callback(std::function<void(CEC::cec_user_control_code)> f) { callback_ = std::move(f); }
+    CEC_Input(const CEC_Input &) = delete;
+    CEC_Input &operator=(const CEC_Input &) = delete;
 
-    void power_tv_on();
+    // Note - f is not going to be called from the main thread
+    void register_callback(std::function<void(CEC::cec_user_control_code)> f);
 
-    operator bool() const { return adapter_; }
-    operator CEC::ICECAdapter* () { return adapter_; }
-    operator const CEC::ICECAdapter* () const { return adapter_; }
-    CEC::ICECAdapter * operator->() { return adapter_; }
-    const CEC::ICECAdapter * operator->() const { return adapter_; }
+    // doesn't block. Done once the adapter is open, if it can be
+    void power_tv_on();
 };
 
 #endif // CEC_HPP
@@ -0,0 +1,100 @@
+#include "decode_pool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+Decode_pool::Decode_pool(unsigned int num_threads, Image_cache * cache):
+    cache_{cache}
+{
+    if(num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(auto i = 0u; i < num_threads; ++i)
+        threads_.emplace_back(&Decode_pool::worker, this);
+}
+
+Decode_pool::~Decode_pool()
+{
+    {
+        auto lock = std::scoped_lock{mutex_};
+        stopping_ = true;
+        jobs_.clear();
+    }
+    cv_.notify_all();
+
+    for(auto & t: threads_)
+        t.join();
+}
+
+void Decode_pool::register_callback(std::function<void()> f)
+{
+    auto lock = std::scoped_lock{mutex_};
+    callback_ = std::move(f);
+}
+
+void Decode_pool::submit(std::size_t id, const std::string & img_path, int viewport_width, int viewport_height)
+{
+    {
+        auto lock = std::scoped_lock{mutex_};
+        latest_[id] = ++serial_;
+        std::erase_if(jobs_, [id](const auto & job) { return job.id == id; });
+        jobs_.emplace_back(Job{id, generation_, serial_, img_path, viewport_width, viewport_height});
+    }
+    cv_.notify_one();
+}
+
+void Decode_pool::cancel()
+{
+    auto lock = std::scoped_lock{mutex_};
+    ++generation_;
+    latest_.clear();
+    jobs_.clear();
+    results_.clear();
+}
+
+std::vector<Decode_pool::Result> Decode_pool::collect()
+{
+    auto lock = std::scoped_lock{mutex_};
+    return std::exchange(results_, {});
+}
+
+void Decode_pool::worker()
+{
+    while(true)
+    {
+        auto job = Job{};
+        {
+            auto lock = std::unique_lock{mutex_};
+            cv_.wait(lock, [this]{ return stopping_ || !std::empty(jobs_); });
+            if(stopping_)
+                return;
+
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        auto result = Result{job.id, {}, {}};
+        try
+        {
+            result.decoded = SDL::decode_image(job.img_path, job.viewport_width, job.viewport_height, cache_);
+        }
+        catch(const std::runtime_error & e)
+        {
+            result.error = e.what();
+        }
+
+        auto callback = std::function<void()>{};
+        {
+            auto lock = std::scoped_lock{mutex_};
+            // superseded. A file edited mid-decode is submitted again, and the stale decode mustn't land after the new one
+            if(job.generation != generation_ || latest_[job.id] != job.serial)
+                continue;
+            latest_.erase(job.id);
+
+            results_.emplace_back(std::move(result));
+            callback = callback_;
+        }
+        callback();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef DECODE_POOL_HPP
+#define DECODE_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "image_cache.hpp"
+#include "texture.hpp"
+
+// Worker threads that decode images into CPU pixel buffers. Uploading them to textures is left to the render thread
+class Decode_pool
+{
+public:
+    struct Result
+    {
+        std::size_t id {0};
+        std::optional<SDL::Decoded_image> decoded;
+        std::string error;
+    };
+
+    // num_threads == 0 uses one thread per core
+    explicit Decode_pool(unsigned int num_threads = 0, Image_cache * cache = nullptr);
+    ~Decode_pool();
+
+    Decode_pool(const Decode_pool &) = delete;
+    Decode_pool &operator=(const Decode_pool &) = delete;
+
+    // called from a worker thread whenever a result becomes available
+    void register_callback(std::function<void()> f);
+
+    // resubmitting an id supersedes its earlier job: that one's result is dropped, even if it's already being decoded
+    void submit(std::size_t id, const std::string & img_path, int viewport_width, int viewport_height);
+    // drop all queued jobs, and the results of any currently in progress
+    void cancel();
+    // take all finished results without blocking
+    std::vector<Result> collect();
+
+    std::size_t size() const { return std::size(threads_); }
+
+private:
+    struct Job
+    {
+        std::size_t id {0};
+        unsigned int generation {0};
+        unsigned int serial {0};
+        std::string img_path;
+        int viewport_width {0};
+        int viewport_height {0};
+    };
+
+    Image_cache * cache_ {nullptr};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ {false};
+    unsigned int generation_ {0};
+    unsigned int serial_ {0};
+    std::unordered_map<std::size_t, unsigned int> latest_; // id -> serial of its latest job
+    std::deque<Job> jobs_;
+    std::vector<Result> results_;
+    std::function<void()> callback_ = []{};
+
+    std::vector<std::thread> threads_;
+
+    void worker();
+};
+
+#endif // DECODE_POOL_HPP
@@ -0,0 +1,140 @@
+// Checks that a thumbnail rewritten in place while it's being decoded can't crash the launcher or leave it showing
+// the old image: every decode either succeeds or fails with an error, and a resubmitted decode supersedes the old one
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <png.h>
+
+#include "decode_pool.hpp"
+#include "test_util.hpp"
+#include "texture.hpp"
+
+namespace
+{
+    // noise, so it doesn't compress, and the file is big enough for a rewrite to land mid-decode
+    std::vector<unsigned char> make_png(int width, int height)
+    {
+        auto pixels = std::vector<unsigned char>(static_cast<std::size_t>(width) * height * 4);
+        auto seed = 1u;
+        for(auto & p: pixels)
+        {
+            seed = seed * 1103515245u + 12345u;
+            p = static_cast<unsigned char>(seed >> 16);
+        }
+
+        png_image png;
+        std::memset(&png, 0, sizeof(png));
+        png.version = PNG_IMAGE_VERSION;
+        png.width = width;
+        png.height = height;
+        png.format = PNG_FORMAT_RGBA;
+
+        png_alloc_size_t size = 0;
+        if(!png_image_write_to_memory(&png, nullptr, &size, 0, std::data(pixels), 0, nullptr))
+            throw std::runtime_error{"Could not size PNG: " + std::string{png.message}};
+        auto data = std::vector<unsigned char>(size);
+        if(!png_image_write_to_memory(&png, std::data(data), &size, 0, std::data(pixels), 0, nullptr))
+            throw std::runtime_error{"Could not write PNG: " + std::string{png.message}};
+        data.resize(size);
+        return data;
+    }
+
+    // the way an image editor saving over a file does it: truncate, then write a piece at a time
+    void rewrite_in_place(const std::string & path, const std::vector<unsigned char> & data)
+    {
+        auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fd < 0)
+            throw std::runtime_error{"Could not open " + path + " - " + std::strerror(errno)};
+        for(auto pos = std::size_t{0}; pos < std::size(data); pos += 4096)
+        {
+            if(write(fd, std::data(data) + pos, std::min(std::size(data) - pos, std::size_t{4096})) < 0)
+                break;
+            std::this_thread::yield();
+        }
+        close(fd);
+    }
+
+    constexpr auto viewport = 64;
+}
+
+int main()
+{
+    try
+    {
+        auto temp_dir = Temp_dir{"decode_test"};
+        const auto path = (temp_dir.path() / "thumbnail.png").string();
+
+        // square and wide images, told apart by the size they're shrunk to
+        const auto square = make_png(512, 512);
+        const auto wide = make_png(600, 300);
+        rewrite_in_place(path, square);
+
+        // decode over and over while another thread keeps rewriting the file. Reaching the end without SIGBUS is the
+        // main check
+        auto done = std::atomic_bool{false};
+        auto writer = std::thread{[&]
+        {
+            for(auto i = 0; i < 100; ++i)
+                rewrite_in_place(path, i % 2 ? square : wide); // ending on square
+            done = true;
+        }};
+
+        auto decoded = 0, errors = 0;
+        while(!done)
+        {
+            try
+            {
+                auto image = SDL::decode_image(path, viewport, viewport);
+                check(image.content.w == viewport && (image.content.h == viewport || image.content.h == viewport / 2),
+                        "decode during a rewrite gives one image or the other, got " + std::to_string(image.content.w) + "x" + std::to_string(image.content.h));
+                ++decoded;
+            }
+            catch(const std::runtime_error &)
+            {
+                ++errors;
+            }
+        }
+        writer.join();
+        std::cout<<"Decoded "<<decoded<<" times during rewrites, "<<errors<<" errors\n";
+
+        auto last = SDL::decode_image(path, viewport, viewport);
+        check(last.content.h == viewport, "decode after the last rewrite gives the last image");
+
+        // the first job is either dropped from the queue or superseded while it's decoded. With one worker, nothing can
+        // arrive after the second job's result
+        auto wide_path = (temp_dir.path() / "wide.png").string();
+        rewrite_in_place(wide_path, wide);
+
+        auto pool = Decode_pool{1};
+        pool.submit(0, wide_path, viewport, viewport);
+        pool.submit(0, path, viewport, viewport);
+
+        auto results = std::vector<Decode_pool::Result>{};
+        for(auto start = std::chrono::steady_clock::now(); std::empty(results) && std::chrono::steady_clock::now() - start < std::chrono::seconds{10};)
+        {
+            results = pool.collect();
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        check(std::size(results) == 1, "resubmitting supersedes, got " + std::to_string(std::size(results)) + " results");
+        check(!std::empty(results) && results[0].decoded && results[0].decoded->content.h == viewport, "the resubmitted image is the one decoded");
+    }
+    catch(const std::runtime_error & e)
+    {
+        check(false, e.what());
+    }
+
+    return test_result();
+}
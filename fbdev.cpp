@@ -0,0 +1,287 @@
+#include "fbdev.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // the SDL format with the same layout in memory, or SDL_PIXELFORMAT_UNKNOWN
+    Uint32 sdl_format(const fb_var_screeninfo & var)
+    {
+        auto is = [&var](unsigned int r_offset, unsigned int g_offset, unsigned int b_offset, unsigned int r_len, unsigned int g_len, unsigned int b_len)
+        {
+            return var.red.offset == r_offset && var.green.offset == g_offset && var.blue.offset == b_offset
+                && var.red.length == r_len && var.green.length == g_len && var.blue.length == b_len;
+        };
+
+        if(var.bits_per_pixel == 32 && is(16, 8, 0, 8, 8, 8))
+            return SDL_PIXELFORMAT_RGB888;
+        if(var.bits_per_pixel == 32 && is(0, 8, 16, 8, 8, 8))
+            return SDL_PIXELFORMAT_BGR888;
+        if(var.bits_per_pixel == 16 && is(11, 5, 0, 5, 6, 5))
+            return SDL_PIXELFORMAT_RGB565;
+
+        return SDL_PIXELFORMAT_UNKNOWN;
+    }
+}
+
+Fb_output::Fb_output(const Fb_config & config): path_{config.path}
+{
+    // a file standing in for a device may not exist yet
+    fd_ = open(path_.c_str(), O_RDWR | O_CLOEXEC | (config.create ? O_CREAT : 0), 0644);
+    if(fd_ < 0)
+        throw std::runtime_error{"Error opening framebuffer: " + path_ + " - " + std::strerror(errno)};
+
+    try
+    {
+        if(ioctl(fd_, FBIOGET_VSCREENINFO, &var_) == 0)
+            open_device();
+        else
+            open_file(config);
+
+        auto map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if(map == MAP_FAILED)
+            throw std::runtime_error{"Error mapping framebuffer: " + path_ + " - " + std::strerror(errno)};
+        map_ = static_cast<unsigned char *>(map);
+
+        surface_.emplace(SDL_CreateRGBSurfaceWithFormat(0, width_, height_, bytes_per_pixel_ * 8, format_));
+        if(!*surface_)
+            SDL::sdl_error("Unable to create framebuffer surface");
+    }
+    catch(...)
+    {
+        release();
+        throw;
+    }
+
+    shadow_.resize(static_cast<std::size_t>(width_) * height_ * bytes_per_pixel_);
+
+    std::cout<<"Drawing to "<<(is_device_ ? "framebuffer " : "file ")<<path_<<": "<<width_<<'x'<<height_<<", "
+             <<SDL_GetPixelFormatName(format_)<<(is_double_buffered() ? ", double buffered" : "")<<'\n';
+}
+
+Fb_output::~Fb_output()
+{
+    release();
+}
+
+void Fb_output::open_device()
+{
+    is_device_ = true;
+    original_var_ = var_;
+
+    fb_fix_screeninfo fix {};
+    if(ioctl(fd_, FBIOGET_FSCREENINFO, &fix) < 0)
+        throw std::runtime_error{"Error reading framebuffer info: " + path_ + " - " + std::strerror(errno)};
+    if(fix.type != FB_TYPE_PACKED_PIXELS || (fix.visual != FB_VISUAL_TRUECOLOR && fix.visual != FB_VISUAL_DIRECTCOLOR))
+        throw std::runtime_error{"Unsupported framebuffer: " + path_ + " is not a packed true color framebuffer"};
+
+    // ask for room for a second frame below the visible one. Drivers that can't just say no
+    if(var_.yres_virtual < 2 * var_.yres)
+    {
+        auto var = var_;
+        var.yres_virtual = 2 * var.yres;
+        var.xoffset = var.yoffset = 0;
+        var.activate = FB_ACTIVATE_NOW;
+        if(ioctl(fd_, FBIOPUT_VSCREENINFO, &var) == 0)
+        {
+            // may have changed more than was asked for
+            if(ioctl(fd_, FBIOGET_VSCREENINFO, &var_) < 0 || ioctl(fd_, FBIOGET_FSCREENINFO, &fix) < 0)
+                throw std::runtime_error{"Error reading framebuffer info: " + path_ + " - " + std::strerror(errno)};
+        }
+    }
+
+    format_ = sdl_format(var_);
+    if(format_ == SDL_PIXELFORMAT_UNKNOWN)
+        throw std::runtime_error{"Unsupported framebuffer: " + path_ + " has an unsupported pixel format (" + std::to_string(var_.bits_per_pixel) + " bpp)"};
+
+    width_ = static_cast<int>(var_.xres);
+    height_ = static_cast<int>(var_.yres);
+    bytes_per_pixel_ = static_cast<int>(var_.bits_per_pixel / 8);
+    line_length_ = fix.line_length;
+    map_size_ = fix.smem_len;
+
+    if(var_.yres_virtual >= 2 * var_.yres && map_size_ >= 2 * line_length_ * height_)
+    {
+        var_.xoffset = var_.yoffset = 0;
+        if(ioctl(fd_, FBIOPAN_DISPLAY, &var_) == 0)
+            num_buffers_ = 2;
+    }
+
+    // without a second buffer to pan to, at least try not to copy mid scan out
+    wait_for_vsync_ = num_buffers_ == 1;
+}
+
+void Fb_output::open_file(const Fb_config & config)
+{
+    struct stat st;
+    if(fstat(fd_, &st) < 0)
+        throw std::runtime_error{"Error reading framebuffer: " + path_ + " - " + std::strerror(errno)};
+    if(!S_ISREG(st.st_mode))
+        throw std::runtime_error{"Error opening framebuffer: " + path_ + " is neither a framebuffer device nor a regular file"};
+    if(config.file_width <= 0 || config.file_height <= 0)
+        throw std::runtime_error{"Error opening framebuffer: " + path_ + " - invalid size"};
+
+    format_ = SDL_PIXELFORMAT_RGB888;
+    width_ = config.file_width;
+    height_ = config.file_height;
+    bytes_per_pixel_ = 4;
+    line_length_ = static_cast<std::size_t>(width_) * bytes_per_pixel_;
+    map_size_ = line_length_ * height_;
+
+    if(static_cast<std::size_t>(st.st_size) < map_size_ && ftruncate(fd_, static_cast<off_t>(map_size_)) < 0)
+        throw std::runtime_error{"Error resizing framebuffer file: " + path_ + " - " + std::strerror(errno)};
+}
+
+void Fb_output::release()
+{
+    if(map_)
+    {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+
+    // put the console back how it was
+    if(is_device_ && (var_.yres_virtual != original_var_.yres_virtual || var_.yoffset != original_var_.yoffset))
+    {
+        original_var_.activate = FB_ACTIVATE_NOW;
+        ioctl(fd_, FBIOPUT_VSCREENINFO, &original_var_);
+    }
+
+    if(fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+void Fb_output::present()
+{
+    find_damage();
+
+    auto changed = [](const std::vector<Span> & damage)
+    {
+        return std::any_of(std::begin(damage), std::end(damage), [](const Span & s) { return s.x0 != s.x1; });
+    };
+    if(!changed(damage_) && (num_buffers_ == 1 || !changed(prev_damage_)))
+        return;
+
+    if(num_buffers_ == 2)
+    {
+        auto back_buffer = 1 - front_buffer_;
+        write_spans(back_buffer * height_);
+
+        var_.xoffset = 0;
+        var_.yoffset = static_cast<__u32>(back_buffer * height_);
+        if(ioctl(fd_, FBIOPAN_DISPLAY, &var_) == 0)
+        {
+            front_buffer_ = back_buffer;
+        }
+        else
+        {
+            std::cerr<<"Error panning framebuffer, falling back to single buffering: "<<std::strerror(errno)<<'\n';
+            var_.yoffset = static_cast<__u32>(front_buffer_ * height_);
+            num_buffers_ = 1;
+
+            // the one still on screen may be two frames behind
+            std::fill(std::begin(damage_), std::end(damage_), Span{0, width_});
+            write_spans(static_cast<int>(var_.yoffset));
+        }
+    }
+    else
+    {
+        if(wait_for_vsync_)
+        {
+            __u32 crtc = 0;
+            if(ioctl(fd_, FBIO_WAITFORVSYNC, &crtc) < 0)
+                wait_for_vsync_ = false;
+        }
+        // wherever the console left the visible area
+        write_spans(static_cast<int>(var_.yoffset));
+    }
+
+    std::swap(prev_damage_, damage_);
+}
+
+// Compare the surface to the last frame, a scanline at a time, and update the last frame to match.
+// Within a scanline, only what's between the first and last changed pixels counts
+void Fb_output::find_damage()
+{
+    const auto num_bands = (height_ + band_height - 1) / band_height;
+    damage_.assign(num_bands, Span{});
+
+    auto surface = surface_->surface;
+    const auto row_bytes = static_cast<std::size_t>(width_) * bytes_per_pixel_;
+    const auto pixels = static_cast<const unsigned char *>(surface->pixels);
+
+    for(auto y = 0; y < height_; ++y)
+    {
+        auto src = pixels + static_cast<std::size_t>(y) * surface->pitch;
+        auto dst = std::data(shadow_) + y * row_bytes;
+
+        auto x0 = 0, x1 = width_;
+        if(!first_frame_)
+        {
+            if(std::memcmp(src, dst, row_bytes) == 0)
+                continue;
+
+            auto first = std::mismatch(src, src + row_bytes, dst).first - src;
+            auto last = std::mismatch(std::make_reverse_iterator(src + row_bytes), std::make_reverse_iterator(src),
+                    std::make_reverse_iterator(dst + row_bytes)).first.base() - src;
+
+            x0 = static_cast<int>(first) / bytes_per_pixel_;
+            x1 = static_cast<int>(last + bytes_per_pixel_ - 1) / bytes_per_pixel_;
+        }
+        std::memcpy(dst + x0 * bytes_per_pixel_, src + x0 * bytes_per_pixel_, static_cast<std::size_t>(x1 - x0) * bytes_per_pixel_);
+
+        auto & span = damage_[y / band_height];
+        if(span.x0 == span.x1)
+            span = Span{x0, x1};
+        else
+            span = Span{std::min(span.x0, x0), std::max(span.x1, x1)};
+    }
+
+    first_frame_ = false;
+}
+
+// Copy the changed spans from the last frame into the frame starting at first_line. When double buffered, that frame was
+// last written two frames ago, so it's also missing what changed the frame before
+void Fb_output::write_spans(int first_line)
+{
+    const auto row_bytes = static_cast<std::size_t>(width_) * bytes_per_pixel_;
+    auto base = map_ + static_cast<std::size_t>(first_line) * line_length_;
+
+    for(auto band = 0; band < static_cast<int>(std::size(damage_)); ++band)
+    {
+        auto span = damage_[band];
+        if(num_buffers_ == 2 && band < static_cast<int>(std::size(prev_damage_)))
+        {
+            auto prev = prev_damage_[band];
+            if(span.x0 == span.x1)
+                span = prev;
+            else if(prev.x0 != prev.x1)
+                span = Span{std::min(span.x0, prev.x0), std::max(span.x1, prev.x1)};
+        }
+        if(span.x0 == span.x1)
+            continue;
+
+        const auto offset = static_cast<std::size_t>(span.x0) * bytes_per_pixel_;
+        const auto size = static_cast<std::size_t>(span.x1 - span.x0) * bytes_per_pixel_;
+        for(auto y = band * band_height; y < std::min(height_, (band + 1) * band_height); ++y)
+        {
+            std::memcpy(base + y * line_length_ + offset, std::data(shadow_) + y * row_bytes + offset, size);
+            bytes_written_ += size;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef FBDEV_HPP
+#define FBDEV_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <linux/fb.h>
+
+#include "sdl.hpp"
+
+struct Fb_config
+{
+    std::string path; // empty to draw through SDL's own renderer instead
+    // create path as a regular file if it doesn't exist. Only for a file standing in for a device: a mistyped or not yet
+    // present device must fail to open, not quietly become a file
+    bool create {false};
+    // size of a regular file standing in for a device
+    int file_width {1280};
+    int file_height {720};
+};
+
+// Draws straight to a Linux framebuffer device, for systems without working KMS or GL. Frames are rendered into a CPU
+// surface in the device's pixel format, and only what changed since the last frame is copied to the mapped device.
+// If the device's virtual screen can be made two frames tall, it's double buffered by panning between them.
+// A regular file can stand in for the device, for testing. It's created if it doesn't exist and config.create is set, and
+// written as a single 32 bit XRGB frame
+class Fb_output
+{
+public:
+    explicit Fb_output(const Fb_config & config);
+    ~Fb_output();
+
+    Fb_output(const Fb_output &) = delete;
+    Fb_output &operator=(const Fb_output &) = delete;
+
+    // render into this (see SDL::Renderer's surface constructor), then present()
+    SDL::Surface & get_surface() { return *surface_; }
+
+    // copy the parts of the surface that changed to the screen, and show them
+    void present();
+
+    bool is_double_buffered() const { return num_buffers_ == 2; }
+    // total copied to the framebuffer by present()
+    std::uint64_t get_bytes_written() const { return bytes_written_; }
+
+private:
+    // changes are tracked per band of this many scanlines
+    static constexpr int band_height = 16;
+
+    // changed pixels [x0, x1) within a band. Empty if x0 == x1
+    struct Span
+    {
+        int x0 {0};
+        int x1 {0};
+    };
+
+    std::string path_;
+    int fd_ {-1};
+    bool is_device_ {false};
+    fb_var_screeninfo original_var_ {};
+    fb_var_screeninfo var_ {};
+
+    unsigned char * map_ {nullptr};
+    std::size_t map_size_ {0};
+
+    int width_ {0};
+    int height_ {0};
+    int bytes_per_pixel_ {0};
+    std::size_t line_length_ {0};
+
+    Uint32 format_ {SDL_PIXELFORMAT_UNKNOWN};
+
+    int num_buffers_ {1};
+    int front_buffer_ {0}; // the one being displayed
+    bool wait_for_vsync_ {false};
+
+    std::optional<SDL::Surface> surface_;
+    std::vector<unsigned char> shadow_; // the last frame presented, tightly packed
+    std::vector<Span> damage_;          // what changed in the last frame
+    std::vector<Span> prev_damage_;     // and the one before, which the back buffer is also missing
+    bool first_frame_ {true};
+
+    std::uint64_t bytes_written_ {0};
+
+    void open_device();
+    void open_file(const Fb_config & config);
+    void release();
+
+    void find_damage();
+    void write_spans(int first_line);
+};
+
+#endif // FBDEV_HPP
@@ -0,0 +1,106 @@
+// Checks Fb_output against a regular file standing in for a framebuffer device: that what's presented ends up in the
+// file, and that only what changed is copied
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstring>
+
+#include "fbdev.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    constexpr auto width = 64;
+    constexpr auto height = 48; // 3 bands
+
+    std::vector<unsigned char> read_file(const std::filesystem::path & path)
+    {
+        auto in = std::ifstream{path, std::ios::binary};
+        return {std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    }
+
+    // the file is tightly packed XRGB, the surface may be padded
+    bool file_matches(const std::filesystem::path & path, const SDL_Surface * surface)
+    {
+        auto file = read_file(path);
+        if(std::size(file) != static_cast<std::size_t>(width) * height * 4)
+            return false;
+
+        for(auto y = 0; y < height; ++y)
+        {
+            if(std::memcmp(std::data(file) + y * width * 4, static_cast<const unsigned char *>(surface->pixels) + y * surface->pitch, width * 4) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    Uint32 & pixel(SDL_Surface * surface, int x, int y)
+    {
+        return reinterpret_cast<Uint32 *>(static_cast<unsigned char *>(surface->pixels) + y * surface->pitch)[x];
+    }
+}
+
+int main()
+{
+    try
+    {
+        auto temp_dir = Temp_dir{"fbdev_test"};
+        // doesn't exist yet
+        const auto path = temp_dir.path() / "fb.raw";
+
+        // a missing device is an error, unless a file was asked for
+        auto opened = true;
+        try
+        {
+            Fb_output{Fb_config{.path = path.string()}};
+        }
+        catch(const std::runtime_error &)
+        {
+            opened = false;
+        }
+        check(!opened && !std::filesystem::exists(path), "a missing path isn't created without create");
+
+        auto fb = Fb_output{Fb_config{.path = path.string(), .create = true, .file_width = width, .file_height = height}};
+        auto surface = fb.get_surface().surface;
+
+        check(!fb.is_double_buffered(), "a file is single buffered");
+
+        // the first frame is copied whole
+        for(auto y = 0; y < height; ++y)
+        {
+            for(auto x = 0; x < width; ++x)
+                pixel(surface, x, y) = static_cast<Uint32>(y * width + x) * 0x010203;
+        }
+        fb.present();
+        check(fb.get_bytes_written() == static_cast<std::uint64_t>(width) * height * 4, "first frame writes everything");
+        check(file_matches(path, surface), "file matches the first frame");
+
+        // nothing changed, nothing copied
+        auto written = fb.get_bytes_written();
+        fb.present();
+        check(fb.get_bytes_written() == written, "unchanged frame writes nothing");
+
+        // changes in the middle band only: its lines are copied between the leftmost and rightmost changed pixels
+        pixel(surface, 10, 20) = 0xFF0000;
+        pixel(surface, 30, 21) = 0x00FF00;
+        pixel(surface, 5, 31) = 0x0000FF;
+        written = fb.get_bytes_written();
+        fb.present();
+        check(fb.get_bytes_written() - written == 16 * (31 - 5) * 4, "change within one band writes only its span, got "
+                + std::to_string(fb.get_bytes_written() - written) + " bytes");
+        check(file_matches(path, surface), "file matches after a partial update");
+    }
+    catch(const std::runtime_error & e)
+    {
+        check(false, e.what());
+    }
+
+    return test_result();
+}
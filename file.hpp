@@ -0,0 +1,85 @@
+#ifndef FILE_HPP
+#define FILE_HPP
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only file, read with pread. Use this instead of Mmap for files the launcher doesn't write itself: if one is
+// truncated while mapped, touching the pages past its new end raises SIGBUS, where a read just comes up short
+class File
+{
+private:
+    int fd_ {-1};
+    std::string path_;
+
+public:
+    explicit File(const std::string & path): path_{path}
+    {
+        fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd_ < 0)
+            throw std::runtime_error {"Error opening input file: " + path + " - " + std::strerror(errno)};
+    }
+    ~File()
+    {
+        if(fd_ >= 0)
+            close(fd_);
+    }
+
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    // the size right now. It may have changed by the time it's read
+    std::size_t size() const
+    {
+        struct stat st;
+        if(fstat(fd_, &st) < 0)
+            throw std::runtime_error {"Error reading input file: " + path_ + " - " + std::strerror(errno)};
+        return static_cast<std::size_t>(st.st_size);
+    }
+
+    // read up to size bytes at offset, returning how many were read. Fewer only at the end of the file
+    std::size_t read_at(std::size_t offset, void * dst, std::size_t size) const
+    {
+        auto total = std::size_t{0};
+        while(total < size)
+        {
+            auto n = pread(fd_, static_cast<char *>(dst) + total, size - total, static_cast<off_t>(offset + total));
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n < 0)
+                throw std::runtime_error {"Error reading input file: " + path_ + " - " + std::strerror(errno)};
+            if(n == 0)
+                break;
+            total += static_cast<std::size_t>(n);
+        }
+        return total;
+    }
+
+    // read all of it, however long it is by the time the end is reached
+    std::vector<char> read_all() const
+    {
+        // one byte spare, so that reading all of an unchanged file comes up short
+        auto data = std::vector<char>(size() + 1);
+        auto total = read_at(0, std::data(data), std::size(data));
+
+        // it grew. Keep reading until a read comes up short
+        while(total == std::size(data))
+        {
+            data.resize(std::max(std::size(data) * 2, std::size_t{4096}));
+            total += read_at(total, std::data(data) + total, std::size(data) - total);
+        }
+        data.resize(total);
+        return data;
+    }
+};
+
+#endif // FILE_HPP
@@ -0,0 +1,144 @@
+#include "file_watcher.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace
+{
+    // a finished write, something renamed into place, or a deletion
+    constexpr auto watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_ONLYDIR;
+
+    std::string normalize(const std::string & path)
+    {
+        std::error_code ec;
+        auto abs = std::filesystem::absolute(path, ec);
+        return (ec ? std::filesystem::path{path} : abs).lexically_normal().string();
+    }
+}
+
+File_watcher::File_watcher()
+{
+    inotify_fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if(inotify_fd_ < 0)
+        throw std::runtime_error{std::string{"Could not initialize inotify: "} + std::strerror(errno)};
+
+    if(pipe2(quit_pipe_, O_CLOEXEC) != 0)
+    {
+        auto err = errno;
+        close(inotify_fd_);
+        throw std::runtime_error{std::string{"Could not create file watcher pipe: "} + std::strerror(err)};
+    }
+
+    thread_ = std::thread{&File_watcher::run, this};
+}
+
+File_watcher::~File_watcher()
+{
+    [[maybe_unused]] auto ret = write(quit_pipe_[1], "q", 1);
+    thread_.join();
+
+    close(quit_pipe_[0]);
+    close(quit_pipe_[1]);
+    close(inotify_fd_);
+}
+
+void File_watcher::register_callback(std::function<void()> f)
+{
+    auto lock = std::scoped_lock{mutex_};
+    callback_ = std::move(f);
+}
+
+void File_watcher::watch(const std::vector<std::string> & paths)
+{
+    auto lock = std::scoped_lock{mutex_};
+
+    files_.clear();
+    auto wanted_dirs = std::unordered_set<std::string>{};
+    for(auto & path: paths)
+    {
+        auto abs = normalize(path);
+        wanted_dirs.insert(std::filesystem::path{abs}.parent_path().string());
+        files_.emplace(std::move(abs), path);
+    }
+
+    for(auto dir = std::begin(dirs_); dir != std::end(dirs_);)
+    {
+        if(wanted_dirs.erase(dir->second) == 0)
+        {
+            inotify_rm_watch(inotify_fd_, dir->first);
+            dir = dirs_.erase(dir);
+        }
+        else
+            ++dir;
+    }
+
+    for(auto & dir: wanted_dirs)
+    {
+        auto wd = inotify_add_watch(inotify_fd_, dir.c_str(), watch_mask);
+        if(wd < 0)
+            std::cerr<<"Could not watch "<<dir<<" for changes: "<<std::strerror(errno)<<'\n';
+        else
+            dirs_[wd] = dir;
+    }
+}
+
+std::set<std::string> File_watcher::take_changes()
+{
+    auto lock = std::scoped_lock{mutex_};
+    return std::exchange(changes_, {});
+}
+
+void File_watcher::run()
+{
+    alignas(inotify_event) char buffer[4096];
+
+    while(true)
+    {
+        pollfd fds[] = {{inotify_fd_, POLLIN, 0}, {quit_pipe_[0], POLLIN, 0}};
+        if(poll(fds, 2, -1) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            std::cerr<<"Error waiting for file changes: "<<std::strerror(errno)<<'\n';
+            return;
+        }
+        if(fds[1].revents)
+            return;
+
+        auto lock = std::scoped_lock{mutex_};
+        auto changed = false;
+        for(auto len = read(inotify_fd_, buffer, sizeof(buffer)); len > 0; len = read(inotify_fd_, buffer, sizeof(buffer)))
+        {
+            for(auto p = buffer; p < buffer + len;)
+            {
+                auto ev = reinterpret_cast<const inotify_event *>(p);
+                p += sizeof(inotify_event) + ev->len;
+
+                auto dir = dirs_.find(ev->wd);
+                if(dir == std::end(dirs_) || ev->len == 0)
+                    continue;
+
+                auto file = files_.find((std::filesystem::path{dir->second} / ev->name).string());
+                if(file != std::end(files_))
+                {
+                    changes_.insert(file->second);
+                    changed = true;
+                }
+            }
+        }
+
+        if(changed)
+            callback_();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches a set of files with inotify from a background thread. The files' directories are watched rather than the
+// files themselves, so that files replaced by renaming over them (as most editors do) are still seen
+class File_watcher
+{
+public:
+    File_watcher();
+    ~File_watcher();
+
+    File_watcher(const File_watcher &) = delete;
+    File_watcher &operator=(const File_watcher &) = delete;
+
+    // Note - this is not going to be called from the main thread
+    void register_callback(std::function<void()> f);
+
+    // replace the set of watched files
+    void watch(const std::vector<std::string> & paths);
+
+    // the watched files (as passed to watch) that changed since the last call
+    std::set<std::string> take_changes();
+
+private:
+    int inotify_fd_ {-1};
+    int quit_pipe_[2] {-1, -1};
+
+    std::mutex mutex_;
+    std::unordered_map<int, std::string> dirs_; // watch descriptor -> directory
+    std::unordered_map<std::string, std::string> files_; // normalized absolute path -> path as given
+    std::set<std::string> changes_;
+    std::function<void()> callback_ = []{};
+
+    std::thread thread_;
+
+    void run();
+};
+
+#endif // FILE_WATCHER_HPP
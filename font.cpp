@@ -1,26 +1,49 @@
 #include "font.hpp"
 
-#include <fontconfig/fontconfig.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <sstream>
 #include <stdexcept>
 
+#include <fontconfig/fontconfig.h>
+#include <sys/stat.h>
+
 namespace {
+    // loads the configuration only. The font directories aren't scanned until build_fonts
     struct Fontconfig
     {
         FcConfig * config {nullptr};
         Fontconfig()
         {
-            if(!FcInit())
+            config = FcInitLoadConfig();
+            if(!config)
                 throw std::runtime_error{"Error loading fontconfig library"};
-            config = FcInitLoadConfigAndFonts();
         }
         ~Fontconfig()
         {
             FcConfigDestroy(config);
             FcFini();
         }
+        void build_fonts()
+        {
+            if(!FcConfigBuildFonts(config))
+                throw std::runtime_error{"Error loading fonts"};
+        }
         operator FcConfig *() { return config; }
         operator const FcConfig *() const { return config; }
     };
+    struct StrList
+    {
+        FcStrList * list{nullptr};
+        explicit StrList(FcStrList * list): list{list} {}
+        ~StrList() { if(list) FcStrListDone(list); }
+        operator FcStrList*() { return list; }
+    };
     struct Pattern
     {
         FcPattern * pat{nullptr};
@@ -41,18 +64,166 @@ namespace {
         FcPattern* operator[](int i) { return set->fonts[i]; }
         const FcPattern* operator[](int i) const { return set->fonts[i]; }
     };
-}
 
-namespace SDL
-{
-    Font::Font(const std::string font_name, int ptsize)
+    // decode UTF-8, replacing malformed sequences with U+FFFD
+    std::vector<Uint32> decode_utf8(std::string_view text)
+    {
+        auto codepoints = std::vector<Uint32>{};
+        codepoints.reserve(std::size(text));
+
+        for(auto i = std::size_t{0}; i < std::size(text);)
+        {
+            auto c = static_cast<unsigned char>(text[i++]);
+            auto len = 0;
+            auto ch = Uint32{c};
+            if(c >= 0xF0 && c < 0xF8)      { len = 3; ch = c & 0x07; }
+            else if(c >= 0xE0 && c < 0xF0) { len = 2; ch = c & 0x0F; }
+            else if(c >= 0xC0 && c < 0xE0) { len = 1; ch = c & 0x1F; }
+            else if(c >= 0x80)             { codepoints.push_back(0xFFFD); continue; }
+
+            for(; len > 0; --len, ++i)
+            {
+                if(i >= std::size(text) || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80)
+                    break;
+                ch = (ch << 6) | (static_cast<unsigned char>(text[i]) & 0x3F);
+            }
+            codepoints.push_back(len == 0 ? ch : 0xFFFD);
+        }
+
+        return codepoints;
+    }
+
+    bool is_space(Uint32 ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+
+    // Process-lifetime font lookup. Fonts are re-created on every resize and whenever the menu comes back from running
+    // an app, and a fontconfig scan plus opening the font file each time is slow. Font names are resolved to files once
+    // (and remembered on disk until fontconfig's caches change), and open fonts are shared. A font is closed once no
+    // SDL::Font uses it, so sizes left behind by a resize don't keep their files open
+    class Font_resolver
+    {
+    public:
+        static Font_resolver & get()
+        {
+            static Font_resolver resolver;
+            return resolver;
+        }
+
+        // each open must be matched by a close
+        TTF_Font * open(const std::string & font_name, int ptsize);
+        void close(TTF_Font * font);
+
+    private:
+        Font_resolver();
+        ~Font_resolver();
+
+        std::string resolve(const std::string & font_name);
+        std::string cache_stamp();
+        void load_paths();
+        void save_paths();
+
+        Fontconfig fc_;
+        bool fonts_built_ {false};
+
+        std::string paths_file_;
+        std::string stamp_;
+        std::unordered_map<std::string, std::string> paths_;
+
+        struct Open_font
+        {
+            TTF_Font * font {nullptr};
+            int refs {0};
+        };
+        std::map<std::pair<std::string, int>, Open_font> fonts_;
+    };
+
+    // same location as Image_cache
+    std::string font_cache_path()
+    {
+        if(auto xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+            return std::string{xdg} + "/fb_launcher/fonts";
+        else if(auto home = std::getenv("HOME"); home && *home)
+            return std::string{home} + "/.cache/fb_launcher/fonts";
+        else
+            return {};
+    }
+
+    Font_resolver::Font_resolver(): paths_file_{font_cache_path()}
+    {
+        // hold our own reference, so cached fonts outlive any one SDL::TTF
+        if(TTF_Init() < 0)
+            SDL::ttf_error("Unable to initialize TTF");
+
+        stamp_ = cache_stamp();
+        load_paths();
+    }
+
+    Font_resolver::~Font_resolver()
+    {
+        for(auto & [key, open]: fonts_)
+            TTF_CloseFont(open.font);
+        TTF_Quit();
+    }
+
+    TTF_Font * Font_resolver::open(const std::string & font_name, int ptsize)
+    {
+        auto path = resolve(font_name);
+
+        if(auto found = fonts_.find({path, ptsize}); found != std::end(fonts_))
+        {
+            ++found->second.refs;
+            return found->second.font;
+        }
+
+        auto font = TTF_OpenFont(path.c_str(), ptsize);
+        if(!font && fonts_built_)
+            SDL::ttf_error("Unable to load font");
+
+        if(!font)
+        {
+            // remembered path is stale. Look it up properly
+            paths_.erase(font_name);
+            path = resolve(font_name);
+            if(auto found = fonts_.find({path, ptsize}); found != std::end(fonts_))
+            {
+                ++found->second.refs;
+                return found->second.font;
+            }
+
+            font = TTF_OpenFont(path.c_str(), ptsize);
+            if(!font)
+                SDL::ttf_error("Unable to load font");
+        }
+
+        fonts_.emplace(std::pair{path, ptsize}, Open_font{font, 1});
+        return font;
+    }
+
+    void Font_resolver::close(TTF_Font * font)
+    {
+        auto found = std::find_if(std::begin(fonts_), std::end(fonts_), [font](const auto & f) { return f.second.font == font; });
+        if(found == std::end(fonts_) || --found->second.refs > 0)
+            return;
+
+        TTF_CloseFont(font);
+        fonts_.erase(found);
+    }
+
+    std::string Font_resolver::resolve(const std::string & font_name)
     {
-        auto fc = Fontconfig{};
+        if(auto found = paths_.find(font_name); found != std::end(paths_))
+            return found->second;
+
+        if(!fonts_built_)
+        {
+            fc_.build_fonts();
+            fonts_built_ = true;
+        }
+
         auto font_pat = Pattern{FcNameParse(reinterpret_cast<const FcChar8*>(font_name.c_str()))};
-        FcConfigSubstitute(fc, font_pat, FcMatchPattern);
+        FcConfigSubstitute(fc_, font_pat, FcMatchPattern);
         FcDefaultSubstitute(font_pat);
         auto result = FcResult{};
-        auto found_font = Pattern{FcFontMatch(fc, font_pat, &result)};
+        auto found_font = Pattern{FcFontMatch(fc_, font_pat, &result)};
         if(result != FcResultMatch)
             throw std::runtime_error{"Error finding font"};
 
@@ -60,20 +231,228 @@ namespace SDL
         if(FcPatternGetString(found_font, FC_FILE, 0, &font_path) != FcResultMatch)
             throw std::runtime_error{"Could not get font path"};
 
-        font = TTF_OpenFont(reinterpret_cast<const char *>(font_path), ptsize);
-        if(!font)
-            ttf_error("Unable to load font");
+        auto & path = paths_[font_name] = reinterpret_cast<const char *>(font_path);
+        save_paths();
+        return path;
+    }
+
+    // fontconfig rewrites its caches when fonts are installed or removed, and the font directories change with them
+    std::string Font_resolver::cache_stamp()
+    {
+        auto stamp = std::string{};
+        for(auto dirs: {FcConfigGetCacheDirs(fc_), FcConfigGetFontDirs(fc_)})
+        {
+            auto list = StrList{dirs};
+            if(!list)
+                continue;
+            while(auto dir = FcStrListNext(list))
+            {
+                struct stat st;
+                stamp += reinterpret_cast<const char *>(dir);
+                if(stat(reinterpret_cast<const char *>(dir), &st) == 0)
+                    stamp += ":" + std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+                stamp += ";";
+            }
+        }
+
+        std::ostringstream hex;
+        hex<<std::hex<<std::hash<std::string>{}(stamp);
+        return hex.str();
+    }
+
+    // file format: a stamp line, then "name\tpath" lines
+    void Font_resolver::load_paths()
+    {
+        if(paths_file_.empty())
+            return;
+
+        auto in = std::ifstream{paths_file_};
+        auto line = std::string{};
+        if(!std::getline(in, line) || line != stamp_)
+            return;
+
+        while(std::getline(in, line))
+        {
+            auto tab = line.find('\t');
+            if(tab != std::string::npos)
+                paths_.emplace(line.substr(0, tab), line.substr(tab + 1));
+        }
+    }
+
+    void Font_resolver::save_paths()
+    {
+        if(paths_file_.empty())
+            return;
+
+        // don't count on Image_cache having made the directory. It may be disabled
+        auto ec = std::error_code{};
+        std::filesystem::create_directories(std::filesystem::path{paths_file_}.parent_path(), ec);
+
+        // write then rename, so a concurrent reader never sees a partial file
+        auto tmp_path = paths_file_ + ".tmp";
+        {
+            auto out = std::ofstream{tmp_path};
+            if(!out)
+                return;
+            out<<stamp_<<'\n';
+            for(auto & [name, path]: paths_)
+                out<<name<<'\t'<<path<<'\n';
+            if(!out)
+                return;
+        }
+        std::rename(tmp_path.c_str(), paths_file_.c_str());
+    }
+}
+
+namespace SDL
+{
+    Font::Font(const std::string font_name, int ptsize):
+        font{Font_resolver::get().open(font_name, ptsize)}
+    {
+        // only ever touched from the thread drawing the menu
+        static auto next_generation = 0u;
+        generation_ = ++next_generation;
+    }
+
+    Font::~Font()
+    {
+        release();
+    }
+
+    void Font::release()
+    {
+        if(font)
+            Font_resolver::get().close(font);
+        font = nullptr;
+    }
+
+    Font::Glyph & Font::get_glyph(Renderer & renderer, Uint32 ch, const std::function<void(Texture &)> & on_new_glyph)
+    {
+        auto [it, inserted] = glyphs_.try_emplace(ch);
+        auto & glyph = it->second;
+        if(!inserted)
+            return glyph;
+
+        int minx, maxx, miny, maxy, advance;
+        if(TTF_GlyphMetrics32(font, ch, &minx, &maxx, &miny, &maxy, &advance) == 0)
+        {
+            glyph.advance = advance;
+            // SDL_ttf extends a glyph's surface to the left when it overhangs the pen position
+            glyph.x_offset = std::min(0, minx);
+        }
+
+        if(!is_space(ch))
+        {
+            auto surface = Surface{TTF_RenderGlyph32_Blended(font, ch, SDL_Color{0xFF, 0xFF, 0xFF, 0xFF})};
+            if(surface.surface)
+            {
+                glyph.texture = Texture{renderer, surface};
+                if(on_new_glyph)
+                    on_new_glyph(glyph.texture);
+            }
+        }
+
+        return glyph;
     }
 
-    Texture Font::render_text(Renderer & renderer, const std::string & text, SDL_Color color, int wrap_length)
+    Text Font::layout_text(Renderer & renderer, std::string_view text, int wrap_length,
+            const std::function<void(Texture &)> & on_new_glyph)
     {
         if(!font)
-            throw std::runtime_error{"Font::render_text called with no font defined"};
+            throw std::runtime_error{"Font::layout_text called with no font defined"};
+
+        auto codepoints = decode_utf8(text);
+        auto line_skip = TTF_FontLineSkip(font);
+
+        auto layout = Text{};
+        layout.generation_ = generation_;
+        auto line = 0;
+        auto pen_x = 0;
+        auto pending_space = 0; // whitespace before the next word. Dropped if the word wraps
+        auto line_empty = true;
+        auto prev = Uint32{0};
+
+        auto new_line = [&]()
+        {
+            ++line;
+            pen_x = 0;
+            pending_space = 0;
+            line_empty = true;
+            prev = 0;
+        };
+
+        for(auto i = std::size_t{0}; i < std::size(codepoints);)
+        {
+            auto ch = codepoints[i];
+            if(ch == '\n')
+            {
+                new_line();
+                ++i;
+                continue;
+            }
+            if(is_space(ch))
+            {
+                pending_space += get_glyph(renderer, ' ', on_new_glyph).advance;
+                prev = 0;
+                ++i;
+                continue;
+            }
+
+            auto word_end = i;
+            auto word_width = 0;
+            for(auto word_prev = prev; word_end < std::size(codepoints) && codepoints[word_end] != '\n' && !is_space(codepoints[word_end]); ++word_end)
+            {
+                if(word_prev)
+                    word_width += TTF_GetFontKerningSizeGlyphs32(font, word_prev, codepoints[word_end]);
+                word_width += get_glyph(renderer, codepoints[word_end], on_new_glyph).advance;
+                word_prev = codepoints[word_end];
+            }
 
-        auto text_surface = Surface{TTF_RenderUTF8_Blended_Wrapped(font, text.c_str(), color, wrap_length)};
-        if(!text_surface.surface)
-            ttf_error("Could not render text");
+            if(wrap_length > 0 && !line_empty && pen_x + pending_space + word_width > wrap_length)
+                new_line();
 
-        return Texture{renderer, text_surface};
+            pen_x += pending_space;
+            pending_space = 0;
+
+            for(; i < word_end; ++i)
+            {
+                auto & glyph = get_glyph(renderer, codepoints[i], on_new_glyph);
+
+                // break words too long to fit on a line of their own
+                if(wrap_length > 0 && word_width > wrap_length && pen_x > 0 && pen_x + glyph.advance > wrap_length)
+                    new_line();
+
+                if(prev)
+                    pen_x += TTF_GetFontKerningSizeGlyphs32(font, prev, codepoints[i]);
+
+                if(glyph.texture)
+                    layout.quads_.push_back({&glyph.texture, pen_x + glyph.x_offset, line * line_skip});
+
+                pen_x += glyph.advance;
+                prev = codepoints[i];
+                layout.width_ = std::max(layout.width_, pen_x);
+            }
+            line_empty = false;
+        }
+
+        if(!std::empty(codepoints))
+            layout.height_ = line * line_skip + TTF_FontHeight(font);
+
+        return layout;
+    }
+
+    void Font::for_each_glyph(const std::function<void(Texture &)> & f)
+    {
+        for(auto & [ch, glyph]: glyphs_)
+        {
+            if(glyph.texture)
+                f(glyph.texture);
+        }
+    }
+
+    void Text::render(Batch & batch, SDL_Color color, int x, int y) const
+    {
+        for(auto & q: quads_)
+            q.glyph->render(batch, color, x + q.x, y + q.y);
     }
 }
@@ -1,8 +1,13 @@
 #ifndef FONT_HPP
 #define FONT_HPP
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <SDL2/SDL_ttf.h>
 
@@ -25,32 +30,59 @@ namespace SDL
         ~TTF() { TTF_Quit(); }
     };
 
+    // A string laid out as quads of glyphs from a Font. Only valid as long as that Font's glyphs are: check with
+    // Font::is_current before rendering one that may have outlived them
+    class Text
+    {
+    public:
+        // glyphs are rasterized in white, so color tints them
+        void render(Batch & batch, SDL_Color color, int x, int y) const;
+
+        int get_width() const { return width_; }
+        int get_height() const { return height_; }
+
+    private:
+        friend struct Font;
+        struct Quad
+        {
+            Texture * glyph {nullptr};
+            int x {0};
+            int y {0};
+        };
+        std::vector<Quad> quads_;
+        int width_ {0};
+        int height_ {0};
+        unsigned int generation_ {0}; // of the Font's glyphs. 0 if never laid out
+    };
+
     struct Font
     {
+        // shared with every other Font of the same file and size, and closed when the last of them is destroyed
         TTF_Font * font {nullptr};
         Font() = default;
 
         explicit Font(const std::string font_name, int ptsize);
-        ~Font()
-        {
-            if(font)
-                TTF_CloseFont(font);
-        }
+        ~Font();
 
         Font(const Font &) = delete;
         Font &operator=(const Font &) = delete;
 
-        Font(Font && f)
+        // the glyphs move with the font, so Text laid out from f stays valid, and Text from this one doesn't
+        Font(Font && f): glyphs_{std::move(f.glyphs_)}, generation_{f.generation_}
         {
             font = f.font;
             f.font = nullptr;
+            f.generation_ = 0;
         }
         Font &operator=(Font && f)
         {
             if(&f != this)
             {
+                release();
                 font = f.font;
                 f.font = nullptr;
+                glyphs_ = std::move(f.glyphs_);
+                generation_ = std::exchange(f.generation_, 0);
             }
             return *this;
         }
@@ -58,7 +90,31 @@ namespace SDL
         operator const TTF_Font*() const { return font; }
         operator TTF_Font*() { return font; }
 
-        Texture render_text(Renderer & renderer, const std::string & text, SDL_Color color, int wrap_length = 0);
+        // Lay out UTF-8 text, word wrapped at wrap_length pixels (0 for no wrapping). Each glyph is rasterized once and
+        // reused; on_new_glyph is called on the first use of each, eg. to pack it into an atlas
+        Text layout_text(Renderer & renderer, std::string_view text, int wrap_length = 0,
+                const std::function<void(Texture &)> & on_new_glyph = {});
+
+        void for_each_glyph(const std::function<void(Texture &)> & f);
+
+        // whether text was laid out by this font, and its glyphs are still alive
+        bool is_current(const Text & text) const { return generation_ != 0 && text.generation_ == generation_; }
+
+    private:
+        void release();
+
+        struct Glyph
+        {
+            Texture texture; // empty for whitespace
+            int x_offset {0}; // from the pen position to the left of texture
+            int advance {0};
+        };
+        // node based, so Text can point into it
+        std::unordered_map<Uint32, Glyph> glyphs_;
+        // identifies glyphs_, for Text to be checked against. 0 for no font
+        unsigned int generation_ {0};
+
+        Glyph & get_glyph(Renderer & renderer, Uint32 ch, const std::function<void(Texture &)> & on_new_glyph);
     };
 }
 
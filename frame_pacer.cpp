@@ -0,0 +1,46 @@
+#include "frame_pacer.hpp"
+
+#include <iostream>
+#include <thread>
+
+void Frame_pacer::reset(SDL::Window & window, SDL::Renderer & renderer)
+{
+    refresh_rate_ = default_refresh_rate;
+
+    SDL_DisplayMode mode;
+    if(SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0)
+        refresh_rate_ = mode.refresh_rate;
+    else if(auto display = SDL_GetWindowDisplayIndex(window); display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0)
+        refresh_rate_ = mode.refresh_rate;
+
+    frame_period_ = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / refresh_rate_));
+
+    SDL_RendererInfo info;
+    vsync_ = SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+
+    last_present_ = clock::now();
+
+    std::cout<<"Display refresh rate: "<<refresh_rate_<<" Hz, vsync "<<(vsync_ ? "on" : "off")<<'\n';
+}
+
+Frame_pacer::clock::time_point Frame_pacer::predict_present() const
+{
+    auto now = clock::now();
+    if(!vsync_ || now < last_present_)
+        return now;
+
+    // the first vblank that we can still make
+    auto frames = (now - last_present_) / frame_period_ + 1;
+    return last_present_ + frames * frame_period_;
+}
+
+void Frame_pacer::presented()
+{
+    last_present_ = clock::now();
+}
+
+void Frame_pacer::wait_for_next_frame() const
+{
+    if(!vsync_)
+        std::this_thread::sleep_until(last_present_ + frame_period_);
+}
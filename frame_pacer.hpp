@@ -0,0 +1,39 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <chrono>
+
+#include "sdl.hpp"
+
+// Tracks the display's refresh rate and when frames are presented, so animations can be timed against when a frame will
+// actually reach the screen, rather than when it started being drawn
+class Frame_pacer
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // query refresh rate and whether the renderer is vsynced. Call again whenever either may have changed
+    void reset(SDL::Window & window, SDL::Renderer & renderer);
+
+    // best guess of when the frame about to be drawn will be presented
+    clock::time_point predict_present() const;
+
+    // call right after SDL_RenderPresent
+    void presented();
+
+    // without vsync, sleep out the rest of the frame. With vsync, SDL_RenderPresent has already waited for us
+    void wait_for_next_frame() const;
+
+    double get_refresh_rate() const { return refresh_rate_; }
+    bool get_vsync() const { return vsync_; }
+
+private:
+    static constexpr auto default_refresh_rate = 60.0;
+
+    double refresh_rate_ {default_refresh_rate};
+    clock::duration frame_period_ {std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / default_refresh_rate))};
+    bool vsync_ {false};
+    clock::time_point last_present_ {};
+};
+
+#endif // FRAME_PACER_HPP
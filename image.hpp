@@ -0,0 +1,30 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <memory>
+#include <vector>
+
+#include "mmap.hpp"
+
+namespace SDL
+{
+    // Small images, like icons, are drawn with nearest filtering to keep them sharp. Larger ones are filtered
+    inline bool use_nearest_filtering(int width, int height) { return width < 48 || height < 48; }
+
+    // RGBA32 pixel data kept on the CPU side so a texture can be re-uploaded
+    struct Image
+    {
+        std::vector<unsigned char> pixels;
+        int width {0};
+        int height {0};
+
+        // when loaded from the image cache, the pixels are read straight out of the cache file's mapping instead
+        std::shared_ptr<const Mmap> mapping {};
+        std::size_t mapping_offset {0};
+
+        const unsigned char * data() const { return mapping ? mapping->data() + mapping_offset : std::data(pixels); }
+        bool empty() const { return !mapping && std::empty(pixels); }
+    };
+}
+
+#endif // IMAGE_HPP
@@ -0,0 +1,373 @@
+#include "image_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.hpp"
+
+namespace
+{
+    constexpr auto cache_magic = std::array<char, 8>{'F', 'B', 'L', 'C', 'A', 'C', 'H', 'E'};
+    // version 2: SVGs are unpremultiplied
+    // version 3: only the content is stored, with the letterboxed size and content position in the header
+    constexpr std::uint32_t cache_version = 3;
+
+    struct Cache_header
+    {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t rescalable;
+        std::int64_t mtime_sec;
+        std::int64_t mtime_nsec;
+        std::int64_t file_size;
+        std::int32_t viewport_width;
+        std::int32_t viewport_height;
+        std::int32_t width;
+        std::int32_t height;
+        std::int32_t letterboxed_width;
+        std::int32_t letterboxed_height;
+        std::int32_t content_x;
+        std::int32_t content_y;
+        std::uint32_t path_length;
+        std::uint32_t reserved;
+        // followed by the source path, then width * height * 4 bytes of RGBA pixel data
+    };
+
+    struct Source_key
+    {
+        std::int64_t mtime_sec {0};
+        std::int64_t mtime_nsec {0};
+        std::int64_t file_size {0};
+    };
+
+    std::optional<Source_key> stat_source(const std::string & img_path)
+    {
+        struct stat st;
+        if(stat(img_path.c_str(), &st) < 0)
+            return std::nullopt;
+
+        return Source_key{st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_size};
+    }
+
+    // FNV-1a
+    struct Hash
+    {
+        std::uint64_t h {0xcbf29ce484222325ull};
+        void add(const void * data, std::size_t size)
+        {
+            for(auto p = static_cast<const unsigned char *>(data); size--; ++p)
+            {
+                h ^= *p;
+                h *= 0x100000001b3ull;
+            }
+        }
+        template <typename T>
+        void add(const T & t) { add(&t, sizeof(t)); }
+    };
+
+    std::string entry_name(const std::string & img_path, const Source_key & key, int viewport_width, int viewport_height)
+    {
+        auto hash = Hash{};
+        hash.add(std::data(img_path), std::size(img_path));
+        hash.add(key.mtime_sec);
+        hash.add(key.mtime_nsec);
+        hash.add(key.file_size);
+        hash.add(viewport_width);
+        hash.add(viewport_height);
+        hash.add(cache_version);
+
+        static constexpr char hex[] = "0123456789abcdef";
+        auto name = std::string(16, '0');
+        for(auto i = 0; i < 16; ++i)
+            name[15 - i] = hex[(hash.h >> (4 * i)) & 0xF];
+
+        return name + ".rgba";
+    }
+
+    bool make_dirs(const std::string & dir)
+    {
+        for(auto pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1))
+        {
+            auto sub = dir.substr(0, pos);
+            if(mkdir(sub.c_str(), 0755) < 0 && errno != EEXIST)
+                return false;
+            if(pos == std::string::npos)
+                return true;
+        }
+    }
+
+    std::string default_cache_dir()
+    {
+        if(auto xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+            return std::string{xdg} + "/fb_launcher";
+        else if(auto home = std::getenv("HOME"); home && *home)
+            return std::string{home} + "/.cache/fb_launcher";
+        else
+            return {};
+    }
+
+    bool write_all(int fd, const void * data, std::size_t size)
+    {
+        auto p = static_cast<const char *>(data);
+        while(size > 0)
+        {
+            auto written = write(fd, p, size);
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            p += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+}
+
+Image_cache::Image_cache(): Image_cache{default_cache_dir()}
+{}
+
+Image_cache::Image_cache(const std::string & dir, std::uint64_t max_bytes): max_bytes_{max_bytes}
+{
+    if(dir.empty())
+    {
+        std::cerr<<"Could not determine cache directory, thumbnail cache disabled\n";
+        return;
+    }
+    if(!make_dirs(dir))
+    {
+        std::cerr<<"Could not create cache directory "<<dir<<": "<<std::strerror(errno)<<", thumbnail cache disabled\n";
+        return;
+    }
+    dir_ = dir;
+}
+
+std::optional<SDL::Decoded_image> Image_cache::load(const std::string & img_path, int viewport_width, int viewport_height)
+{
+    if(!enabled())
+        return std::nullopt;
+
+    auto key = stat_source(img_path);
+    if(!key)
+        return std::nullopt;
+
+    auto entry_path = dir_ + "/" + entry_name(img_path, *key, viewport_width, viewport_height);
+    if(access(entry_path.c_str(), R_OK) != 0)
+    {
+        ++misses_;
+        return std::nullopt;
+    }
+
+    try
+    {
+        auto mapping = std::make_shared<const Mmap>(entry_path);
+
+        Cache_header header;
+        if(mapping->size() < sizeof(header))
+            throw std::runtime_error{"truncated header"};
+        std::memcpy(&header, mapping->data(), sizeof(header));
+
+        const auto pixels_offset = sizeof(header) + header.path_length;
+        if(header.magic != cache_magic || header.version != cache_version
+                || header.mtime_sec != key->mtime_sec || header.mtime_nsec != key->mtime_nsec || header.file_size != key->file_size
+                || header.viewport_width != viewport_width || header.viewport_height != viewport_height
+                || header.width <= 0 || header.height <= 0
+                || header.path_length != std::size(img_path)
+                || mapping->size() != pixels_offset + static_cast<std::size_t>(header.width) * header.height * 4
+                || std::memcmp(mapping->data() + sizeof(header), std::data(img_path), header.path_length) != 0)
+        {
+            throw std::runtime_error{"stale or mismatched entry"};
+        }
+
+        // the entry's mtime isn't part of its key. It's used to find the least recently used entries instead
+        utimensat(AT_FDCWD, entry_path.c_str(), nullptr, 0);
+
+        ++hits_;
+        return SDL::Decoded_image
+        {
+            .image = SDL::Image{{}, header.width, header.height, std::move(mapping), pixels_offset},
+            .rescalable = header.rescalable != 0,
+            .width = header.letterboxed_width,
+            .height = header.letterboxed_height,
+            .content = SDL_Rect{header.content_x, header.content_y, header.width, header.height}
+        };
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<"Ignoring thumbnail cache entry "<<entry_path<<": "<<e.what()<<'\n';
+        unlink(entry_path.c_str());
+        ++misses_;
+        return std::nullopt;
+    }
+}
+
+void Image_cache::store(const std::string & img_path, int viewport_width, int viewport_height, const SDL::Decoded_image & decoded)
+{
+    const auto & image = decoded.image;
+    if(!enabled() || image.empty())
+        return;
+
+    auto key = stat_source(img_path);
+    if(!key)
+        return;
+
+    auto header = Cache_header{};
+    header.magic = cache_magic;
+    header.version = cache_version;
+    header.rescalable = decoded.rescalable;
+    header.mtime_sec = key->mtime_sec;
+    header.mtime_nsec = key->mtime_nsec;
+    header.file_size = key->file_size;
+    header.viewport_width = viewport_width;
+    header.viewport_height = viewport_height;
+    header.width = image.width;
+    header.height = image.height;
+    header.letterboxed_width = decoded.width;
+    header.letterboxed_height = decoded.height;
+    header.content_x = decoded.content.x;
+    header.content_y = decoded.content.y;
+    header.path_length = static_cast<std::uint32_t>(std::size(img_path));
+
+    // write to a temp file and rename into place, so readers never see a partial entry
+    auto entry_path = dir_ + "/" + entry_name(img_path, *key, viewport_width, viewport_height);
+    auto tmp_path = entry_path + ".XXXXXX";
+    auto fd = mkstemp(std::data(tmp_path));
+    if(fd < 0)
+    {
+        std::cerr<<"Could not create thumbnail cache entry "<<entry_path<<": "<<std::strerror(errno)<<'\n';
+        return;
+    }
+
+    auto ok = write_all(fd, &header, sizeof(header))
+        && write_all(fd, std::data(img_path), std::size(img_path))
+        && write_all(fd, image.data(), static_cast<std::size_t>(image.width) * image.height * 4);
+
+    if(close(fd) < 0)
+        ok = false;
+
+    if(!ok || rename(tmp_path.c_str(), entry_path.c_str()) < 0)
+    {
+        std::cerr<<"Could not write thumbnail cache entry "<<entry_path<<": "<<std::strerror(errno)<<'\n';
+        unlink(tmp_path.c_str());
+        return;
+    }
+
+    used_ += sizeof(header) + std::size(img_path) + static_cast<std::uint64_t>(image.width) * image.height * 4;
+    if(!scanned_.exchange(true) || used_ > max_bytes_)
+        prune();
+}
+
+// Called from whichever decode thread's store needs it. Another thread already pruning is left to it
+void Image_cache::prune()
+{
+    auto lock = std::unique_lock{prune_mutex_, std::try_to_lock};
+    if(!lock)
+        return;
+
+    struct Entry
+    {
+        std::string path;
+        std::uint64_t size {0};
+        std::filesystem::file_time_type last_used;
+    };
+    auto entries = std::vector<Entry>{};
+    auto total = std::uint64_t{0};
+    auto stale = 0, least_used = 0;
+
+    auto ec = std::error_code{};
+    auto files = std::vector<std::filesystem::directory_entry>{};
+    try
+    {
+        for(auto & file: std::filesystem::directory_iterator{dir_, ec})
+            files.push_back(file);
+    }
+    catch(const std::filesystem::filesystem_error &)
+    {} // prune what was listed
+
+    for(auto & file: files)
+    {
+        auto path = file.path().string();
+        auto last_used = file.last_write_time(ec);
+        if(ec)
+            continue;
+
+        // left by a store that never finished. One still being written would be much newer than this
+        if(path.find(".rgba.") != std::string::npos)
+        {
+            if(std::filesystem::file_time_type::clock::now() - last_used > std::chrono::hours{1})
+                unlink(path.c_str());
+            continue;
+        }
+        if(file.path().extension() != ".rgba")
+            continue;
+
+        // an entry can never be hit again once its source is gone or changed
+        auto header = Cache_header{};
+        auto current = false;
+        try
+        {
+            auto entry = File{path};
+            if(entry.read_at(0, &header, sizeof(header)) == sizeof(header) && header.magic == cache_magic && header.path_length <= 4096)
+            {
+                auto img_path = std::string(header.path_length, '\0');
+                if(entry.read_at(sizeof(header), std::data(img_path), std::size(img_path)) == std::size(img_path))
+                {
+                    auto key = stat_source(img_path);
+                    current = key && key->mtime_sec == header.mtime_sec && key->mtime_nsec == header.mtime_nsec
+                        && key->file_size == header.file_size;
+                }
+            }
+        }
+        catch(const std::runtime_error &)
+        {}
+
+        if(!current)
+        {
+            unlink(path.c_str());
+            ++stale;
+            continue;
+        }
+
+        auto size = file.file_size(ec);
+        if(ec)
+            continue;
+        entries.push_back(Entry{std::move(path), size, last_used});
+        total += size;
+    }
+
+    // prune to 3/4 of the limit, so the next few stores don't each need another pass
+    if(total > max_bytes_)
+    {
+        std::sort(std::begin(entries), std::end(entries), [](const auto & a, const auto & b) { return a.last_used < b.last_used; });
+        for(auto & entry: entries)
+        {
+            if(total <= max_bytes_ / 4 * 3)
+                break;
+            unlink(entry.path.c_str());
+            total -= entry.size;
+            ++least_used;
+        }
+    }
+    used_ = total;
+
+    if(stale || least_used)
+    {
+        std::cout<<"Thumbnail cache: removed "<<stale<<" stale and "<<least_used<<" least recently used entries, "
+                 <<total / (1024 * 1024)<<" of "<<max_bytes_ / (1024 * 1024)<<" MiB used\n";
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef IMAGE_CACHE_HPP
+#define IMAGE_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "texture.hpp"
+
+// On-disk cache of decoded RGBA images and their letterboxing, so a warm start doesn't need to touch libpng or librsvg.
+// Entries are named by a hash of the source path, mtime, size and the requested viewport, and are memory-mapped on load.
+// The cache is kept to max_bytes: entries whose source is gone or has changed are removed, then the least recently used
+// ones. That's checked on the first store, and again whenever stores take it over max_bytes
+class Image_cache
+{
+public:
+    static constexpr std::uint64_t default_max_bytes = 256 * 1024 * 1024;
+
+    // uses $XDG_CACHE_HOME/fb_launcher (or ~/.cache/fb_launcher). If that can't be created, caching is disabled
+    Image_cache();
+    explicit Image_cache(const std::string & dir, std::uint64_t max_bytes = default_max_bytes);
+
+    // load and store are safe to call from multiple threads
+    std::optional<SDL::Decoded_image> load(const std::string & img_path, int viewport_width, int viewport_height);
+    void store(const std::string & img_path, int viewport_width, int viewport_height, const SDL::Decoded_image & decoded);
+
+    bool enabled() const { return !dir_.empty(); }
+    int get_hits() const { return hits_; }
+    int get_misses() const { return misses_; }
+
+private:
+    std::string dir_;
+    std::uint64_t max_bytes_ {default_max_bytes};
+    std::atomic<int> hits_ {0};
+    std::atomic<int> misses_ {0};
+
+    std::mutex prune_mutex_;
+    std::atomic<bool> scanned_ {false};
+    std::atomic<std::uint64_t> used_ {0}; // approximate, between prunes
+
+    void prune();
+};
+
+#endif // IMAGE_CACHE_HPP
@@ -0,0 +1,144 @@
+#include "latency.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr const char * source_names[Latency_tracker::num_sources] = {"keyboard", "joystick", "gamepad", "CEC"};
+
+    constexpr char report_msg = 'r';
+    constexpr char quit_msg = 'q';
+
+    // write end of the pipe the signal handler wakes the watching thread with
+    volatile std::sig_atomic_t signal_fd = -1;
+
+    extern "C" void report_signal_handler(int)
+    {
+        auto saved_errno = errno;
+        [[maybe_unused]] auto ret = write(signal_fd, &report_msg, 1);
+        errno = saved_errno;
+    }
+
+    // nearest-rank percentile of sorted samples
+    Latency_tracker::clock::duration percentile(const std::vector<Latency_tracker::clock::duration> & sorted, int p)
+    {
+        auto rank = (p * std::size(sorted) + 99) / 100;
+        return sorted[std::max<std::size_t>(rank, 1) - 1];
+    }
+
+    struct Ms
+    {
+        Latency_tracker::clock::duration d;
+    };
+    std::ostream & operator<<(std::ostream & os, Ms ms)
+    {
+        return os<<std::fixed<<std::setprecision(2)<<std::chrono::duration<double, std::milli>{ms.d}.count()<<std::defaultfloat;
+    }
+}
+
+Latency_tracker::clock::time_point Latency_tracker::queued_at(Uint32 sdl_timestamp)
+{
+    return clock::now() - std::chrono::milliseconds{SDL_GetTicks() - sdl_timestamp};
+}
+
+Latency_tracker::Latency_tracker(bool enabled):
+    enabled_{enabled}
+{
+    if(!enabled_)
+        return;
+
+    // A handler and a pipe rather than blocking the signal and using sigwait, because a blocked signal mask
+    // would be inherited by every app we launch
+    if(pipe2(signal_pipe_, O_CLOEXEC) != 0)
+        throw std::runtime_error{std::string{"Could not create latency report pipe: "} + std::strerror(errno)};
+
+    signal_fd = signal_pipe_[1];
+
+    struct sigaction action {};
+    action.sa_handler = report_signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, nullptr);
+
+    signal_thread_ = std::thread{[this]
+    {
+        char msg;
+        while(read(signal_pipe_[0], &msg, 1) == 1 && msg == report_msg)
+        {
+            auto lock = std::scoped_lock{callback_mutex_};
+            callback_();
+        }
+    }};
+}
+
+Latency_tracker::~Latency_tracker()
+{
+    if(!enabled_)
+        return;
+
+    // not back to the default, which would kill us if another arrived
+    signal(SIGUSR1, SIG_IGN);
+    signal_fd = -1;
+
+    [[maybe_unused]] auto ret = write(signal_pipe_[1], &quit_msg, 1);
+    signal_thread_.join();
+
+    close(signal_pipe_[0]);
+    close(signal_pipe_[1]);
+}
+
+void Latency_tracker::register_callback(std::function<void()> f)
+{
+    auto lock = std::scoped_lock{callback_mutex_};
+    callback_ = std::move(f);
+}
+
+void Latency_tracker::input(const Input & in)
+{
+    if(enabled_)
+        pending_.push_back(in);
+}
+
+void Latency_tracker::presented(clock::time_point time)
+{
+    for(auto & in: pending_)
+        samples_[static_cast<int>(in.source)].push_back(time - in.time);
+    pending_.clear();
+}
+
+void Latency_tracker::report(std::ostream & os) const
+{
+    if(!enabled_)
+        return;
+
+    os<<"Input to present latency (ms):\n";
+    for(auto i = 0; i < num_sources; ++i)
+    {
+        os<<"  "<<std::left<<std::setw(10)<<source_names[i]<<std::right;
+
+        if(std::empty(samples_[i]))
+        {
+            os<<"no samples\n";
+            continue;
+        }
+
+        auto sorted = samples_[i];
+        std::sort(std::begin(sorted), std::end(sorted));
+
+        os<<"n="<<std::size(sorted)
+          <<" p50="<<Ms{percentile(sorted, 50)}
+          <<" p95="<<Ms{percentile(sorted, 95)}
+          <<" p99="<<Ms{percentile(sorted, 99)}
+          <<" max="<<Ms{sorted.back()}<<'\n';
+    }
+    os.flush();
+}
@@ -0,0 +1,66 @@
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+// Measures time from an input event to the SDL_RenderPresent of the first frame that shows its effect
+class Latency_tracker
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    enum class Source {KEYBOARD, JOYSTICK, GAMEPAD, CEC};
+    static constexpr auto num_sources = 4;
+
+    struct Input
+    {
+        Source source;
+        clock::time_point time;
+    };
+
+    // When an event being handled now was queued, from its SDL timestamp. SDL only stamps events to the ms, so this is now
+    // less the whole ms that have passed since. Anything after that is measured exactly
+    static clock::time_point queued_at(Uint32 sdl_timestamp);
+
+    // When enabled, SIGUSR1 calls the report callback (from a background thread)
+    explicit Latency_tracker(bool enabled = false);
+    ~Latency_tracker();
+
+    Latency_tracker(const Latency_tracker &) = delete;
+    Latency_tracker &operator=(const Latency_tracker &) = delete;
+
+    // Note - this is not going to be called from the main thread
+    void register_callback(std::function<void()> f);
+
+    // an input that changed what will be drawn next
+    void input(const Input & in);
+    // call right after SDL_RenderPresent
+    void presented(clock::time_point time);
+    // drop inputs that haven't been presented yet
+    void cancel() { pending_.clear(); }
+
+    // p50 / p95 / p99 for each source
+    void report(std::ostream & os) const;
+
+    bool enabled() const { return enabled_; }
+
+private:
+    bool enabled_ {false};
+    std::vector<Input> pending_;
+    std::array<std::vector<clock::duration>, num_sources> samples_;
+
+    int signal_pipe_[2] {-1, -1};
+    std::thread signal_thread_;
+    std::mutex callback_mutex_;
+    std::function<void()> callback_ = []{};
+};
+
+#endif // LATENCY_HPP
@@ -0,0 +1,315 @@
+#include "launcher.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char ** environ;
+
+namespace
+{
+    // anything that needs /bin/sh to interpret: quoting, expansion, redirection, pipelines, variable assignment, etc.
+    constexpr auto shell_metacharacters = std::string_view{"|&;<>()$`\\\"'*?[]#~={}!\n"};
+
+    constexpr char wake_msg = 'w';
+    constexpr char quit_msg = 'q';
+
+    std::vector<std::string> split_args(const std::string & command)
+    {
+        auto args = std::vector<std::string>{};
+        for(auto pos = command.find_first_not_of(" \t"); pos != std::string::npos; pos = command.find_first_not_of(" \t", pos))
+        {
+            auto end = command.find_first_of(" \t", pos);
+            args.emplace_back(command.substr(pos, end - pos));
+            pos = end;
+        }
+        return args;
+    }
+
+    int pidfd_open(pid_t pid)
+    {
+#ifdef SYS_pidfd_open
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    // on kernels without pidfds, children are checked this often instead
+    constexpr auto fallback_poll_ms = 1000;
+}
+
+Child::Child(const std::string & command): command_{command}
+{
+    auto args = std::vector<std::string>{};
+    if(command.find_first_of(shell_metacharacters) == std::string::npos)
+        args = split_args(command);
+
+    auto use_shell = std::empty(args);
+    if(use_shell)
+        args = {"/bin/sh", "-c", command};
+
+    auto argv = std::vector<char *>{};
+    for(auto & arg: args)
+        argv.push_back(std::data(arg));
+    argv.push_back(nullptr);
+
+    // the write end closes when the child execs (or dies trying), which is how we time the exec
+    int exec_pipe[2];
+    if(pipe2(exec_pipe, O_CLOEXEC) != 0)
+        throw std::runtime_error{"Could not launch " + command + ": " + std::strerror(errno)};
+
+    // we don't ignore or block anything the app should see, but be sure not to pass on anything SDL set up
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t sigdefault;
+    sigemptyset(&sigdefault);
+    for(auto sig: {SIGHUP, SIGINT, SIGQUIT, SIGPIPE, SIGTERM, SIGCHLD, SIGUSR1, SIGUSR2})
+        sigaddset(&sigdefault, sig);
+    posix_spawnattr_setsigdefault(&attr, &sigdefault);
+    sigset_t sigmask;
+    sigemptyset(&sigmask);
+    posix_spawnattr_setsigmask(&attr, &sigmask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    start_ = clock::now();
+    auto err = use_shell ? posix_spawn(&pid_, argv[0], nullptr, &attr, std::data(argv), environ)
+                         : posix_spawnp(&pid_, argv[0], nullptr, &attr, std::data(argv), environ);
+    posix_spawnattr_destroy(&attr);
+    close(exec_pipe[1]);
+
+    if(err != 0)
+    {
+        close(exec_pipe[0]);
+        pid_ = -1;
+        throw std::runtime_error{"Could not launch " + command + ": " + std::strerror(err)};
+    }
+
+    char c;
+    while(read(exec_pipe[0], &c, 1) < 0 && errno == EINTR)
+        ;
+    exec_ = clock::now();
+    close(exec_pipe[0]);
+}
+
+Child::~Child()
+{
+    if(pidfd_ >= 0)
+        close(pidfd_);
+}
+
+Child::Child(Child && c):
+    command_{std::move(c.command_)},
+    pid_{c.pid_},
+    pidfd_{c.pidfd_},
+    reaped_{c.reaped_},
+    exit_code_{c.exit_code_},
+    exit_status_{c.exit_status_},
+    start_{c.start_},
+    exec_{c.exec_},
+    exit_{c.exit_}
+{
+    c.pid_ = -1;
+    c.pidfd_ = -1;
+}
+
+Child &Child::operator=(Child && c)
+{
+    if(&c != this)
+    {
+        if(pidfd_ >= 0)
+            close(pidfd_);
+        command_ = std::move(c.command_);
+        pid_ = c.pid_;
+        pidfd_ = c.pidfd_;
+        reaped_ = c.reaped_;
+        exit_code_ = c.exit_code_;
+        exit_status_ = c.exit_status_;
+        start_ = c.start_;
+        exec_ = c.exec_;
+        exit_ = c.exit_;
+        c.pid_ = -1;
+        c.pidfd_ = -1;
+    }
+    return *this;
+}
+
+void Child::open_pidfd()
+{
+    if(pidfd_ < 0 && pid_ >= 0 && !reaped_)
+        pidfd_ = pidfd_open(pid_);
+}
+
+bool Child::poll()
+{
+    if(reaped_ || pid_ < 0)
+        return true;
+
+    siginfo_t info {};
+    if(waitid(P_PID, pid_, &info, WEXITED | WNOHANG) < 0)
+        return false;
+    if(info.si_pid == 0) // still running
+        return false;
+
+    reaped(info.si_code, info.si_status);
+    return true;
+}
+
+void Child::wait()
+{
+    if(reaped_ || pid_ < 0)
+        return;
+
+    siginfo_t info {};
+    while(waitid(P_PID, pid_, &info, WEXITED) < 0)
+    {
+        if(errno != EINTR)
+            throw std::runtime_error{"Error waiting for " + command_ + ": " + std::strerror(errno)};
+    }
+
+    reaped(info.si_code, info.si_status);
+}
+
+void Child::reaped(int code, int status)
+{
+    exit_ = clock::now();
+    reaped_ = true;
+    exit_code_ = code;
+    exit_status_ = status;
+
+    if(pidfd_ >= 0)
+    {
+        close(pidfd_);
+        pidfd_ = -1;
+    }
+}
+
+void Child::report(std::ostream & os) const
+{
+    using namespace std::chrono;
+    os<<command_<<": exec after "<<duration_cast<duration<double, std::milli>>(get_spawn_to_exec()).count()<<" ms";
+    if(!reaped_)
+    {
+        os<<", still running\n";
+        return;
+    }
+
+    os<<", ran for "<<duration_cast<duration<double>>(get_runtime()).count()<<" s, ";
+    if(exit_code_ == CLD_EXITED)
+        os<<"exited with status "<<exit_status_<<'\n';
+    else
+        os<<"killed by signal "<<exit_status_<<" ("<<strsignal(exit_status_)<<")\n";
+}
+
+Ignore_interrupts::Ignore_interrupts()
+{
+    struct sigaction ignore {};
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGINT, &ignore, &old_int_);
+    sigaction(SIGQUIT, &ignore, &old_quit_);
+}
+
+Ignore_interrupts::~Ignore_interrupts()
+{
+    sigaction(SIGINT, &old_int_, nullptr);
+    sigaction(SIGQUIT, &old_quit_, nullptr);
+}
+
+Child_supervisor::Child_supervisor()
+{
+    if(pipe2(wake_pipe_, O_CLOEXEC) != 0)
+        throw std::runtime_error{std::string{"Could not create child supervisor pipe: "} + std::strerror(errno)};
+
+    thread_ = std::thread{&Child_supervisor::run, this};
+}
+
+Child_supervisor::~Child_supervisor()
+{
+    // Anything still running is left to run. Once we exit, it's reaped by init
+    [[maybe_unused]] auto ret = write(wake_pipe_[1], &quit_msg, 1);
+    thread_.join();
+
+    close(wake_pipe_[0]);
+    close(wake_pipe_[1]);
+}
+
+void Child_supervisor::register_callback(std::function<void()> f)
+{
+    auto lock = std::scoped_lock{mutex_};
+    callback_ = std::move(f);
+}
+
+void Child_supervisor::add(Child && child)
+{
+    child.open_pidfd();
+    {
+        auto lock = std::scoped_lock{mutex_};
+        running_.push_back(std::move(child));
+    }
+    [[maybe_unused]] auto ret = write(wake_pipe_[1], &wake_msg, 1);
+}
+
+std::vector<Child> Child_supervisor::collect()
+{
+    auto lock = std::scoped_lock{mutex_};
+    return std::exchange(exited_, {});
+}
+
+std::size_t Child_supervisor::get_running()
+{
+    auto lock = std::scoped_lock{mutex_};
+    return std::size(running_);
+}
+
+void Child_supervisor::run()
+{
+    while(true)
+    {
+        auto fds = std::vector<pollfd>{{wake_pipe_[0], POLLIN, 0}};
+        auto timeout = -1;
+        {
+            auto lock = std::scoped_lock{mutex_};
+            for(auto & child: running_)
+            {
+                if(child.get_pidfd() >= 0)
+                    fds.push_back({child.get_pidfd(), POLLIN, 0});
+                else
+                    timeout = fallback_poll_ms;
+            }
+        }
+
+        if(::poll(std::data(fds), std::size(fds), timeout) < 0 && errno != EINTR)
+            return;
+
+        if(fds[0].revents)
+        {
+            char msg;
+            if(read(wake_pipe_[0], &msg, 1) == 1 && msg == quit_msg)
+                return;
+        }
+
+        auto lock = std::scoped_lock{mutex_};
+        auto exited = std::stable_partition(std::begin(running_), std::end(running_), [](Child & c) { return !c.poll(); });
+        if(exited == std::end(running_))
+            continue;
+
+        std::move(exited, std::end(running_), std::back_inserter(exited_));
+        running_.erase(exited, std::end(running_));
+        callback_();
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef LAUNCHER_HPP
+#define LAUNCHER_HPP
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/types.h>
+
+// A launched command. Commands without shell syntax are exec'd directly rather than through /bin/sh
+class Child
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // start command, returning once it has exec'd. Throws std::runtime_error if it can't be started
+    explicit Child(const std::string & command);
+    ~Child();
+
+    Child(const Child &) = delete;
+    Child &operator=(const Child &) = delete;
+    Child(Child && c);
+    Child &operator=(Child && c);
+
+    // reap the child if it has exited, without blocking. Returns true once it has been reaped
+    bool poll();
+    // block until the child exits
+    void wait();
+
+    const std::string & get_command() const { return command_; }
+    pid_t get_pid() const { return pid_; }
+    // for polling, rather than waiting. -1 if not opened, or the kernel doesn't support pidfds
+    int get_pidfd() const { return pidfd_; }
+    void open_pidfd();
+
+    clock::duration get_spawn_to_exec() const { return exec_ - start_; }
+    // from exec to exit
+    clock::duration get_runtime() const { return exit_ - exec_; }
+
+    // how long it took to start and run, and how it exited
+    void report(std::ostream & os) const;
+
+private:
+    std::string command_;
+    pid_t pid_ {-1};
+    int pidfd_ {-1};
+    bool reaped_ {false};
+    int exit_code_ {0};
+    int exit_status_ {0};
+
+    clock::time_point start_ {};
+    clock::time_point exec_ {};
+    clock::time_point exit_ {};
+
+    void reaped(int code, int status);
+};
+
+// Like std::system, ignore SIGINT and SIGQUIT while a foreground app runs, so that Ctrl+C and Ctrl+\ on the console
+// only reach the app. Restores the previous handlers (eg. SDL's) when destroyed. Children get the defaults back (see Child)
+class Ignore_interrupts
+{
+public:
+    Ignore_interrupts();
+    ~Ignore_interrupts();
+
+    Ignore_interrupts(const Ignore_interrupts &) = delete;
+    Ignore_interrupts &operator=(const Ignore_interrupts &) = delete;
+
+private:
+    struct sigaction old_int_ {};
+    struct sigaction old_quit_ {};
+};
+
+// Reaps children started in the background from a thread polling their pidfds, so the event loop never blocks on them
+class Child_supervisor
+{
+public:
+    Child_supervisor();
+    ~Child_supervisor();
+
+    Child_supervisor(const Child_supervisor &) = delete;
+    Child_supervisor &operator=(const Child_supervisor &) = delete;
+
+    // Note - this is not going to be called from the main thread
+    void register_callback(std::function<void()> f);
+
+    void add(Child && child);
+    // take the children that have exited since the last call
+    std::vector<Child> collect();
+    std::size_t get_running();
+
+private:
+    int wake_pipe_[2] {-1, -1};
+
+    std::mutex mutex_;
+    std::vector<Child> running_;
+    std::vector<Child> exited_;
+    std::function<void()> callback_ = []{};
+
+    std::thread thread_;
+
+    void run();
+};
+
+#endif // LAUNCHER_HPP
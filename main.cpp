@@ -1,14 +1,17 @@
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 #include <cstdlib>
 
 #include "app.hpp"
+#include "launcher.hpp"
 #include "menu.hpp"
 
 void usage()
 {
-    std::cout<<"Usage: fb_launcher [-l] [-e] [-c COMMAND] [-h] APP_LIST_CSV\n"
+    std::cout<<"Usage: fb_launcher [-l] [-e] [-c COMMAND] [-j THREADS] [-w ROWS] [-m MIB] [-L] [-f FBDEV] [-h] APP_LIST_CSV\n"
+               "       fb_launcher --compile APP_LIST_CSV CATALOG\n"
                "Display a launcher for a set of apps (defined in APP_LIST_CSV)\n"
                "Can be run from the linux console without X or Wayland,\n"
                "and can be controlled with keyboard, gamepad, or at TV remote via CEC\n"
@@ -16,10 +19,27 @@ void usage()
                "Arguments\n"
                "  -l             Launch first program in list without displaying launcher\n"
                "  -e             Enable pressing escape to quit\n"
-               "  -c             Set a command to be executed on pressing Ctrl+Shift+Esc\n"
+               "  -c             Set a command to be executed on pressing Ctrl+Shift+Esc.\n"
+               "                 The menu keeps running while it does\n"
+               "  -j             Number of threads used to decode thumbnails (default: one per CPU core)\n"
+               "  -w             Number of rows on either side of the selection to keep loaded (default: 8)\n"
+               "  -m             Texture memory budget, in MiB. When exceeded, thumbnails are\n"
+               "                 downscaled, then ones not on screen are dropped. Texture atlas\n"
+               "                 pages are kept to half of it (default: no limit)\n"
+               "  -L             Measure input to present latency. Percentiles are printed\n"
+               "                 on exit, or when sent SIGUSR1\n"
+               "  -f             Draw with the CPU straight to framebuffer device FBDEV (eg. /dev/fb0),\n"
+               "                 copying only what changed each frame. For systems without working\n"
+               "                 KMS or GL. Input still comes through SDL, so pair it with a video\n"
+               "                 driver that doesn't need the display, eg. SDL_VIDEODRIVER=evdev.\n"
+               "                 A regular file may be given instead, for testing. It's written as a\n"
+               "                 1280x720 32 bit XRGB frame\n"
                "  -h             Display this message and exit\n"
                "  APP_LIST_CSV   A CSV file containing the list of apps to display\n"
-               "                 See below for file format\n"
+               "                 See below for file format. May also be a catalog made\n"
+               "                 with --compile\n"
+               "  --compile      Compile APP_LIST_CSV into a binary CATALOG that loads faster.\n"
+               "                 If the CSV changes afterwards, it is read instead of the catalog\n"
                "\n"
                "CSV file columns\n"
                "  Title:          Name of program\n"
@@ -48,6 +68,31 @@ int main(int argc, char * argv[])
     auto selection_index = -1;
     auto allow_escape = false;
     auto ctrl_alt_del_cmd = std::string{};
+    auto decode_threads = 0u;
+    auto residency_window = 8;
+    auto measure_latency = false;
+    auto texture_budget = std::size_t{0};
+    auto fbdev = Fb_config{};
+
+    if(argc > 1 && std::string{argv[1]} == "--compile")
+    {
+        if(argc != 4)
+        {
+            usage();
+            std::cerr<<"\n--compile requires APP_LIST_CSV and CATALOG arguments\n";
+            return 1;
+        }
+        try
+        {
+            compile_app_list(argv[2], argv[3]);
+        }
+        catch(const std::runtime_error & e)
+        {
+            std::cerr<<e.what()<<'\n';
+            return 1;
+        }
+        return 0;
+    }
 
     for(int i = 1; i < argc;)
     {
@@ -76,6 +121,93 @@ int main(int argc, char * argv[])
                     allow_escape = true;
                     break;
 
+                case 'j':
+                    if(i + 1 >= argc)
+                    {
+                        usage();
+                        std::cerr<<"\n-j requires argument\n";
+                        return 1;
+                    }
+
+                    nargs = 2;
+                    try
+                    {
+                        auto threads = std::stoi(argv[i + 1]);
+                        if(threads < 1)
+                            throw std::out_of_range{"-j"};
+                        decode_threads = static_cast<unsigned int>(threads);
+                    }
+                    catch(const std::logic_error &)
+                    {
+                        usage();
+                        std::cerr<<"\n-j requires a positive integer argument\n";
+                        return 1;
+                    }
+                    break;
+
+                case 'w':
+                    if(i + 1 >= argc)
+                    {
+                        usage();
+                        std::cerr<<"\n-w requires argument\n";
+                        return 1;
+                    }
+
+                    nargs = 2;
+                    try
+                    {
+                        residency_window = std::stoi(argv[i + 1]);
+                        if(residency_window < 2)
+                            throw std::out_of_range{"-w"};
+                    }
+                    catch(const std::logic_error &)
+                    {
+                        usage();
+                        std::cerr<<"\n-w requires an integer argument of at least 2\n";
+                        return 1;
+                    }
+                    break;
+
+                case 'm':
+                    if(i + 1 >= argc)
+                    {
+                        usage();
+                        std::cerr<<"\n-m requires argument\n";
+                        return 1;
+                    }
+
+                    nargs = 2;
+                    try
+                    {
+                        auto mib = std::stoi(argv[i + 1]);
+                        if(mib < 1)
+                            throw std::out_of_range{"-m"};
+                        texture_budget = static_cast<std::size_t>(mib) * 1024 * 1024;
+                    }
+                    catch(const std::logic_error &)
+                    {
+                        usage();
+                        std::cerr<<"\n-m requires a positive integer argument\n";
+                        return 1;
+                    }
+                    break;
+
+                case 'L':
+                    measure_latency = true;
+                    break;
+
+                case 'f':
+                    if(i + 1 >= argc)
+                    {
+                        usage();
+                        std::cerr<<"\n-f requires argument\n";
+                        return 1;
+                    }
+
+                    nargs = 2;
+                    fbdev.path = argv[i + 1];
+                    break;
+
                 case 'h':
                     usage();
                     return 0;
@@ -109,25 +241,51 @@ int main(int argc, char * argv[])
 
     try
     {
-        auto apps = read_app_list(argv[1]);
+        auto app_list = read_app_list(argv[1]);
+        auto & apps = app_list.get_apps();
 
-        while(true)
+        auto launch = [&apps](int index)
         {
-            if(selection_index >= 0 && selection_index < static_cast<int>(std::size(apps)))
+            if(index >= 0 && index < static_cast<int>(std::size(apps)))
             {
-                std::cout<<"Launching "<<apps[selection_index].title<<" ("<<apps[selection_index].command<<")\n";
+                std::cout<<"Launching "<<apps[index].title<<" ("<<apps[index].command<<")\n";
                 std::cout.flush();
-                std::system(apps[selection_index].command.c_str());
+                try
+                {
+                    // from before it starts, so there's no window where Ctrl+C ends the launcher instead
+                    auto ignore_interrupts = Ignore_interrupts{};
+                    auto child = Child{std::string{apps[index].command}};
+                    child.wait();
+                    child.report(std::cout);
+                }
+                catch(const std::runtime_error & e)
+                {
+                    std::cerr<<e.what()<<'\n';
+                }
             }
+        };
 
-            std::cout<<"Loading menu...\n";
-            auto menu = Menu{apps, allow_escape, selection_index, ctrl_alt_del_cmd};
+        launch(selection_index);
 
+        std::cout<<"Loading menu...\n";
+        auto menu = Menu{app_list, allow_escape, selection_index, ctrl_alt_del_cmd, decode_threads, residency_window, measure_latency, texture_budget, fbdev};
+
+        while(true)
+        {
             selection_index = menu.run();
-            std::cout<<"Exiting menu...\n";
 
             if(menu.get_exited())
+            {
+                std::cout<<"Exiting menu...\n";
+                std::cout<<"Frames rendered: "<<menu.get_frames_rendered()<<", skipped: "<<menu.get_frames_skipped()<<'\n';
+                menu.report_texture_memory();
+                menu.report_latency();
                 break;
+            }
+
+            menu.suspend();
+            launch(selection_index);
+            menu.resume();
         }
     }
     catch(const std::runtime_error & e)
@@ -1,9 +1,14 @@
 #include "menu.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
-#include <thread>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace
@@ -35,10 +40,41 @@ namespace
 
     constexpr auto animation_duration = std::chrono::milliseconds{200};
 
-    constexpr auto framerate = 60.0f;
-
     constexpr auto animation_event = SDL_USEREVENT;
     constexpr auto cec_event       = SDL_USEREVENT + 1;
+    constexpr auto decode_event    = SDL_USEREVENT + 2;
+    constexpr auto latency_event   = SDL_USEREVENT + 3;
+    constexpr auto reload_event    = SDL_USEREVENT + 4;
+    constexpr auto child_event     = SDL_USEREVENT + 5;
+    constexpr auto populate_event  = SDL_USEREVENT + 6;
+
+    constexpr auto placeholder_color = SDL_Color {0x40, 0x40, 0x40, 0xFF};
+
+    // Which input source an event came from, and when SDL queued it. For CEC that's when the libcec callback pushed it
+    std::optional<Latency_tracker::Input> latency_input(const SDL_Event & ev)
+    {
+        using Source = Latency_tracker::Source;
+        switch(ev.type)
+        {
+            case SDL_KEYDOWN:
+                return Latency_tracker::Input{Source::KEYBOARD, Latency_tracker::queued_at(ev.common.timestamp)};
+
+            case SDL_JOYBUTTONDOWN:
+            case SDL_JOYHATMOTION:
+            case SDL_JOYAXISMOTION:
+                return Latency_tracker::Input{Source::JOYSTICK, Latency_tracker::queued_at(ev.common.timestamp)};
+
+            case SDL_CONTROLLERBUTTONDOWN:
+            case SDL_CONTROLLERAXISMOTION:
+                return Latency_tracker::Input{Source::GAMEPAD, Latency_tracker::queued_at(ev.common.timestamp)};
+
+            case cec_event:
+                return Latency_tracker::Input{Source::CEC, Latency_tracker::queued_at(ev.common.timestamp)};
+
+            default:
+                return std::nullopt;
+        }
+    }
 
 }
 
@@ -51,27 +87,46 @@ extern char _binary_keyboard_svg_start[];
 extern char _binary_mobile_retro_svg_end[];
 extern char _binary_mobile_retro_svg_start[];
 
-Menu::Menu(const std::vector<App> & apps, bool allow_escape, int start_index, const std::string & ctrl_alt_del_cmd):
-    apps_{apps},
+Menu::Menu(App_list & app_list, bool allow_escape, int start_index, const std::string & ctrl_alt_del_cmd,
+        unsigned int decode_threads, int residency_window, bool measure_latency, std::size_t texture_budget,
+        const Fb_config & fbdev):
+    app_list_{app_list},
+    apps_{app_list.get_apps()},
     allow_escape_{allow_escape},
     ctrl_alt_del_cmd_{ctrl_alt_del_cmd},
+    fbdev_config_{fbdev},
     index_{start_index >= 0 ? start_index : 0},
-    mouse_icon_{renderer_, std::span{_binary_computer_mouse_svg_start, static_cast<std::size_t>(_binary_computer_mouse_svg_end - _binary_computer_mouse_svg_start)}, 32, 32},
-    keyboard_icon_{renderer_, std::span{_binary_keyboard_svg_start, static_cast<std::size_t>(_binary_keyboard_svg_end - _binary_keyboard_svg_start)}, 32, 32},
-    gamepad_icon_{renderer_, std::span{_binary_gamepad_svg_start, static_cast<std::size_t>(_binary_gamepad_svg_end - _binary_gamepad_svg_start)}, 32, 32},
-    cec_icon_{renderer_, std::span{_binary_mobile_retro_svg_start, static_cast<std::size_t>(_binary_mobile_retro_svg_end - _binary_mobile_retro_svg_start)}, 32, 32},
-    app_textures_(std::size(apps_))
+    latency_{measure_latency},
+    texture_memory_{texture_budget},
+    residency_{std::size(apps_), std::max(2, residency_window), static_cast<std::size_t>(2 * std::max(2, residency_window))},
+    decode_pool_{decode_threads, &thumbnail_cache_}
 {
+    // Atlas pages are big enough to be most of the budget on their own. Leave at least half for everything else
+    atlas_.account(texture_memory_, texture_budget / 2);
+
+    create_renderer();
+
     SDL_ShowCursor(SDL_DISABLE);
 
+    pacer_.reset(*window_, *renderer_);
+
+    compose_rows_ = SDL_RenderTargetSupported(*renderer_);
+    if(!compose_rows_)
+        std::cout<<"Renderer can't render to textures, menu rows will be drawn directly\n";
+
     cec_.register_callback(std::bind(&Menu::queue_cec_event, this, std::placeholders::_1));
+    decode_pool_.register_callback(std::bind(&Menu::queue_decode_event, this));
+    latency_.register_callback(std::bind(&Menu::queue_latency_report_event, this));
+    file_watcher_.register_callback(std::bind(&Menu::queue_reload_event, this));
+    children_.register_callback(std::bind(&Menu::queue_child_event, this));
+    watch_files();
 
     // NOTE: According to the SDL API, you should call SDL_RegisterEvents before using a user-defined event,
     //       However (at least as of SDL3), all that function does is increment an internal counter and return it.
     //       See https://github.com/libsdl-org/SDL/blob/17965117824d82afd0f6692c8871510f942270f7/src/events/SDL_events.c#L1483
     //       Annoyingly, this counter is never reset, and will continue to increase every time SDL_RegisterEvents,
     //       even after SDL_Quit / SDL_Init
-    //       Since we're repeatedly (stupidly?) recreating our SDL instance, we can't keep calling this.
+    //       Since we tear down and re-initialize the video subsystem around every launch, we can't keep calling this.
     //       For starters, to use the returned value in a switch stmt it needs to be constant, and, eventually,
     //       (though unlikely) we'd run out of values
     //       With all of that in mind, we just won't call SDL_RegisterEvents, and use the fixed values of SDL_USEREVENT + n
@@ -83,6 +138,21 @@ Menu::Menu(const std::vector<App> & apps, bool allow_escape, int start_index, co
 
     // if(SDL_RegisterEvents(1) != cec_event)
     //     SDL::sdl_error("Could not register custom event");
+
+    // if(SDL_RegisterEvents(1) != decode_event)
+    //     SDL::sdl_error("Could not register custom event");
+
+    // if(SDL_RegisterEvents(1) != latency_event)
+    //     SDL::sdl_error("Could not register custom event");
+
+    // if(SDL_RegisterEvents(1) != reload_event)
+    //     SDL::sdl_error("Could not register custom event");
+
+    // if(SDL_RegisterEvents(1) != child_event)
+    //     SDL::sdl_error("Could not register custom event");
+
+    // if(SDL_RegisterEvents(1) != populate_event)
+    //     SDL::sdl_error("Could not register custom event");
 }
 
 int Menu::run()
@@ -93,211 +163,429 @@ int Menu::run()
     // have CEC wake the TV
     cec_.power_tv_on();
 
+    prefetcher_.hover(std::string{apps_[index_].command});
+
+    // Show something right away, rather than waiting for the window's first size event. resize() only builds the
+    // selected row, and everything else is filled in over the following frames
+    if(w_ == 0 || h_ == 0)
+    {
+        int w, h;
+        SDL_GetRendererOutputSize(*renderer_, &w, &h);
+        resize(w, h);
+    }
+    if(dirty_)
+        present_frame();
+
     while(running_)
     {
-        auto frame_start = std::chrono::system_clock::now();
+        if(animation_direction_ == 0)
+            idle_callback_(*window_);
 
         SDL_Event ev;
         if(SDL_WaitEvent(&ev) < 0)
             SDL::sdl_error("Error getting SDL event");
 
-        switch(ev.type)
+        animation_tick_ = false;
+        handle_event(ev);
+
+        // Drain everything else that's already queued, so that a flood of events (mostly analog axis motion) costs one
+        // frame rather than one frame each. Stop as soon as an app is selected so that later events can't change the selection
+        SDL_PumpEvents();
+        while(running_ && SDL_PeepEvents(&ev, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0)
+            handle_event(ev);
+
+        apply_axis_motion();
+
+        if(!running_)
+            break;
+
+        // Only draw when something visible changed. Most events (axis noise, hotplug, unmapped keys, ...) don't,
+        // and while idle we should be blocked in SDL_WaitEvent, not drawing.
+        // While animating, there is always exactly one animation_event in the queue, so other events don't add frames
+        if(!dirty_ && !animation_tick_)
         {
-            case SDL_QUIT:
-                running_ = false;
-                exited_ = true;
-                std::cout<<"Quitting ...\n";
-                break;
+            ++frames_skipped_;
+            continue;
+        }
+
+        present_frame();
+
+        if(animation_direction_ != 0)
+        {
+            SDL_Event ev;
+            SDL_zero(ev);
+            ev.type = animation_event;
+            SDL_PushEvent(&ev);
+
+            pacer_.wait_for_next_frame();
+        }
+    }
+
+    return index_;
+}
 
-            case SDL_WINDOWEVENT:
-                if(ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+void Menu::create_renderer()
+{
+    if(fbdev_config_.path.empty())
+    {
+        renderer_.emplace(*window_, SDL_RENDERER_PRESENTVSYNC);
+    }
+    else
+    {
+        fb_.emplace(fbdev_config_);
+        renderer_.emplace(fb_->get_surface());
+    }
+}
+
+void Menu::present_frame()
+{
+    auto frame_start = Frame_pacer::clock::now();
+
+    SDL_RenderClear(*renderer_);
+    draw();
+    SDL_RenderPresent(*renderer_);
+    if(fb_)
+        fb_->present();
+    pacer_.presented();
+    latency_.presented(Latency_tracker::clock::now());
+
+    auto now = Frame_pacer::clock::now();
+    if(frames_rendered_ == 0)
+    {
+        std::cout<<"First frame after "<<std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(now - start_time_).count()<<" ms\n";
+        if(timings_)
+            timings_->first_present = now;
+    }
+    if(timings_)
+        timings_->frames.push_back(now - frame_start);
+
+    dirty_ = false;
+    ++frames_rendered_;
+
+    // one piece of the rest of the menu per frame. Pushed after presenting, like the animation event, so that the
+    // event loop's draining doesn't do it all before the next frame
+    if(!populate_queued_ && (!std::empty(pending_rows_) || icons_pending_))
+    {
+        SDL_Event ev;
+        SDL_zero(ev);
+        ev.type = populate_event;
+        SDL_PushEvent(&ev);
+        populate_queued_ = true;
+    }
+}
+
+void Menu::handle_event(const SDL_Event & ev)
+{
+    current_input_ = latency_input(ev);
+
+    switch(ev.type)
+    {
+        case SDL_QUIT:
+            running_ = false;
+            exited_ = true;
+            std::cout<<"Quitting ...\n";
+            break;
+
+        case SDL_WINDOWEVENT:
+            switch(ev.window.event)
+            {
+                case SDL_WINDOWEVENT_SIZE_CHANGED:
                 {
                     int w, h;
-                    SDL_GetRendererOutputSize(renderer_, &w, &h);
+                    SDL_GetRendererOutputSize(*renderer_, &w, &h);
 
                     resize(w, h);
+                    break;
                 }
-                break;
 
-            case SDL_JOYDEVICEADDED:
-            {
-                auto joy = SDL::Joystick{ev.jdevice.which};
-                std::cout<<(joy.is_gc() ? "Gamepad" : "Joystick")<<" added: "<<joy.name()<<'\n';
-                joysticks.emplace(SDL_JoystickGetDeviceInstanceID(ev.jdevice.which), std::move(joy));
-                break;
+                case SDL_WINDOWEVENT_SHOWN:
+                case SDL_WINDOWEVENT_EXPOSED:
+                case SDL_WINDOWEVENT_RESTORED:
+                    dirty_ = true;
+                    break;
+
+                default:
+                    break;
             }
+            break;
 
-            case SDL_JOYDEVICEREMOVED:
-                if(auto joy = joysticks.find(ev.jdevice.which); joy != std::end(joysticks))
-                {
-                    std::cout<<(joy->second.is_gc() ? "Gamepad" : "Joystick")<<" removed: "<<joy->second.name()<<'\n';
-                    joysticks.erase(joy);
-                }
-                break;
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            clear_composed_rows();
+            dirty_ = true;
+            break;
 
-            case SDL_KEYDOWN:
-                switch(ev.key.keysym.sym)
-                {
-                    case SDLK_RETURN:
-                    case SDLK_KP_ENTER:
-                        select();
-                        break;
+        case SDL_JOYDEVICEADDED:
+        {
+            auto joy = SDL::Joystick{ev.jdevice.which};
+            std::cout<<(joy.is_gc() ? "Gamepad" : "Joystick")<<" added: "<<joy.name()<<'\n';
+            joysticks.emplace(SDL_JoystickGetDeviceInstanceID(ev.jdevice.which), std::move(joy));
+            break;
+        }
 
-                    case SDLK_ESCAPE:
-                        if(!ctrl_alt_del_cmd_.empty() && (ev.key.keysym.mod & (KMOD_SHIFT | KMOD_CTRL)))
-                        {
-                            std::system(ctrl_alt_del_cmd_.c_str());
-                        }
-                        else if(allow_escape_)
+        case SDL_JOYDEVICEREMOVED:
+            if(auto joy = joysticks.find(ev.jdevice.which); joy != std::end(joysticks))
+            {
+                std::cout<<(joy->second.is_gc() ? "Gamepad" : "Joystick")<<" removed: "<<joy->second.name()<<'\n';
+                joysticks.erase(joy);
+            }
+            break;
+
+        case SDL_KEYDOWN:
+            switch(ev.key.keysym.sym)
+            {
+                case SDLK_RETURN:
+                case SDLK_KP_ENTER:
+                    select();
+                    break;
+
+                case SDLK_ESCAPE:
+                    if(!ctrl_alt_del_cmd_.empty() && (ev.key.keysym.mod & (KMOD_SHIFT | KMOD_CTRL)))
+                    {
+                        if(children_.get_running() > 0)
+                            std::cout<<"Already running "<<ctrl_alt_del_cmd_<<'\n';
+                        else
                         {
-                            running_ = false;
-                            exited_ = true;
+                            try
+                            {
+                                std::cout<<"Running "<<ctrl_alt_del_cmd_<<'\n';
+                                children_.add(Child{ctrl_alt_del_cmd_});
+                            }
+                            catch(const std::runtime_error & e)
+                            {
+                                std::cerr<<e.what()<<'\n';
+                            }
                         }
+                    }
+                    else if(allow_escape_)
+                    {
+                        running_ = false;
+                        exited_ = true;
+                    }
+                    break;
+
+                case SDLK_LEFT:
+                case SDLK_UP:
+                    prev();
+                    break;
+
+                case SDLK_RIGHT:
+                case SDLK_DOWN:
+                    next();
+                    break;
+
+                default:
+                    break;
+            }
+            break;
+
+        case SDL_JOYBUTTONDOWN: // all joystick buttons launch the selected app
+            if(!joysticks.at(ev.jbutton.which).is_gc())
+                select();
+            break;
+
+        case SDL_CONTROLLERBUTTONDOWN:
+            if(joysticks.at(ev.jbutton.which).is_gc())
+            {
+                switch(ev.cbutton.button)
+                {
+                    case SDL_CONTROLLER_BUTTON_A:
+                    case SDL_CONTROLLER_BUTTON_B:
+                    case SDL_CONTROLLER_BUTTON_X:
+                    case SDL_CONTROLLER_BUTTON_Y:
+                    case SDL_CONTROLLER_BUTTON_START:
+                    case SDL_CONTROLLER_BUTTON_BACK:
+                    case SDL_CONTROLLER_BUTTON_GUIDE:
+                        select();
                         break;
 
-                    case SDLK_LEFT:
-                    case SDLK_UP:
+                    case SDL_CONTROLLER_BUTTON_DPAD_UP:
+                    case SDL_CONTROLLER_BUTTON_DPAD_LEFT:
+                    case SDL_CONTROLLER_BUTTON_LEFTSHOULDER:
+                    case SDL_CONTROLLER_BUTTON_LEFTSTICK:
                         prev();
                         break;
 
-                    case SDLK_RIGHT:
-                    case SDLK_DOWN:
+                    case SDL_CONTROLLER_BUTTON_DPAD_RIGHT:
+                    case SDL_CONTROLLER_BUTTON_DPAD_DOWN:
+                    case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER:
+                    case SDL_CONTROLLER_BUTTON_RIGHTSTICK:
                         next();
                         break;
 
                     default:
                         break;
                 }
-                break;
-
-            case SDL_JOYBUTTONDOWN: // all joystick buttons launch the selected app
-                if(!joysticks.at(ev.jbutton.which).is_gc())
-                    select();
-                break;
-
-            case SDL_CONTROLLERBUTTONDOWN:
-                if(joysticks.at(ev.jbutton.which).is_gc())
-                {
-                    switch(ev.cbutton.button)
-                    {
-                        case SDL_CONTROLLER_BUTTON_A:
-                        case SDL_CONTROLLER_BUTTON_B:
-                        case SDL_CONTROLLER_BUTTON_X:
-                        case SDL_CONTROLLER_BUTTON_Y:
-                        case SDL_CONTROLLER_BUTTON_START:
-                        case SDL_CONTROLLER_BUTTON_BACK:
-                        case SDL_CONTROLLER_BUTTON_GUIDE:
-                            select();
-                            break;
-
-                        case SDL_CONTROLLER_BUTTON_DPAD_UP:
-                        case SDL_CONTROLLER_BUTTON_DPAD_LEFT:
-                        case SDL_CONTROLLER_BUTTON_LEFTSHOULDER:
-                        case SDL_CONTROLLER_BUTTON_LEFTSTICK:
-                            prev();
-                            break;
-
-                        case SDL_CONTROLLER_BUTTON_DPAD_RIGHT:
-                        case SDL_CONTROLLER_BUTTON_DPAD_DOWN:
-                        case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER:
-                        case SDL_CONTROLLER_BUTTON_RIGHTSTICK:
-                            next();
-                            break;
-
-                        default:
-                            break;
-                    }
-                }
-                break;
-
-            case SDL_JOYHATMOTION:
-                if(!joysticks.at(ev.jhat.which).is_gc())
-                {
-                    switch(ev.jhat.value)
-                    {
-                        case SDL_HAT_LEFT:
-                        case SDL_HAT_UP:
-                        case SDL_HAT_LEFTUP:
-                            prev();
-                            break;
-
-                        case SDL_HAT_RIGHT:
-                        case SDL_HAT_DOWN:
-                        case SDL_HAT_RIGHTDOWN:
-                            next();
-                            break;
-                        default:
-                            break;
-                    }
-                    break;
-                }
+            }
+            break;
 
-            case SDL_JOYAXISMOTION:
-            case SDL_CONTROLLERAXISMOTION:
+        case SDL_JOYHATMOTION:
+            if(!joysticks.at(ev.jhat.which).is_gc())
             {
-                auto move = joysticks.at(ev.type == SDL_JOYAXISMOTION ? ev.jaxis.which : ev.caxis.which).menu_move(ev);
-
-                switch(move)
+                switch(ev.jhat.value)
                 {
-                    case SDL::Joystick::Dir::PREV:
+                    case SDL_HAT_LEFT:
+                    case SDL_HAT_UP:
+                    case SDL_HAT_LEFTUP:
                         prev();
                         break;
-                    case SDL::Joystick::Dir::NEXT:
+
+                    case SDL_HAT_RIGHT:
+                    case SDL_HAT_DOWN:
+                    case SDL_HAT_RIGHTDOWN:
                         next();
                         break;
                     default:
                         break;
                 }
+            }
+            break;
 
-                break;
+        // Only the latest motion on each axis matters. menu_move reads the current stick position anyway,
+        // so these are just recorded here and handled once per frame in apply_axis_motion.
+        // The first event's timestamp is kept, so measured latency includes the time spent waiting here
+        case SDL_JOYAXISMOTION:
+        case SDL_CONTROLLERAXISMOTION:
+        {
+            auto key = ev.type == SDL_JOYAXISMOTION ? std::tuple{ev.jaxis.which, ev.type, ev.jaxis.axis} : std::tuple{ev.caxis.which, ev.type, ev.caxis.axis};
+            auto [motion, inserted] = pending_axis_motion_.try_emplace(key, ev);
+            if(!inserted)
+            {
+                auto timestamp = motion->second.common.timestamp;
+                motion->second = ev;
+                motion->second.common.timestamp = timestamp;
             }
+            break;
+        }
 
-            case cec_event:
-                switch(ev.user.code)
-                {
-                    using namespace CEC;
+        case cec_event:
+            switch(ev.user.code)
+            {
+                using namespace CEC;
 
-                    case CEC_USER_CONTROL_CODE_UP:
-                    case CEC_USER_CONTROL_CODE_LEFT:
-                        prev();
-                        break;
+                case CEC_USER_CONTROL_CODE_UP:
+                case CEC_USER_CONTROL_CODE_LEFT:
+                    prev();
+                    break;
 
-                    case CEC_USER_CONTROL_CODE_DOWN:
-                    case CEC_USER_CONTROL_CODE_RIGHT:
-                        next();
-                        break;
+                case CEC_USER_CONTROL_CODE_DOWN:
+                case CEC_USER_CONTROL_CODE_RIGHT:
+                    next();
+                    break;
 
-                    case CEC_USER_CONTROL_CODE_SELECT:
-                        select();
-                        break;
+                case CEC_USER_CONTROL_CODE_SELECT:
+                    select();
+                    break;
 
-                    default:
-                        break;
-                }
-                break;
+                default:
+                    break;
+            }
+            break;
+
+        case decode_event:
+            upload_thumbnails();
+            break;
+
+        case animation_event:
+            animation_tick_ = true;
+            break;
 
+        case latency_event:
+            report_latency();
+            break;
+
+        case reload_event:
+            reload_files();
+            break;
+
+        case child_event:
+            report_children();
+            break;
+
+        case populate_event:
+            populate_queued_ = false;
+            populate_step();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Menu::apply_axis_motion()
+{
+    if(!running_)
+    {
+        pending_axis_motion_.clear();
+        return;
+    }
+
+    for(auto && [key, ev]: pending_axis_motion_)
+    {
+        auto joy = joysticks.find(std::get<0>(key));
+        if(joy == std::end(joysticks))
+            continue;
+
+        current_input_ = latency_input(ev);
+        switch(joy->second.menu_move(ev))
+        {
+            case SDL::Joystick::Dir::PREV:
+                prev();
+                break;
+            case SDL::Joystick::Dir::NEXT:
+                next();
+                break;
             default:
                 break;
         }
+    }
+    pending_axis_motion_.clear();
+    current_input_.reset();
+}
 
-        SDL_RenderClear(renderer_);
-        draw();
-        SDL_RenderPresent(renderer_);
+void Menu::suspend()
+{
+    // Textures belong to the renderer, so they have to go with it. Destroying the window and quitting the video
+    // subsystem (rather than just hiding the window) is what releases DRM master and the console on KMSDRM
+    for_each_texture([](SDL::Texture & t) { t.release(); });
+    atlas_.release();
+    clear_composed_rows();
+    // the frame that would have shown these is never going to be drawn
+    latency_.cancel();
+    // too late to help, and would compete with the app for I/O
+    prefetcher_.cancel();
+    renderer_.reset();
+    // the app may want the framebuffer too
+    fb_.reset();
+    window_.reset();
+    video_.reset();
+}
 
-        if(animation_direction_ != 0)
-        {
-            SDL_Event ev;
-            SDL_zero(ev);
-            ev.type = animation_event;
-            SDL_PushEvent(&ev);
-        }
+void Menu::resume()
+{
+    video_.emplace(SDL_INIT_VIDEO);
+    window_.emplace("fb_launcher");
+    create_renderer();
 
-        auto now = std::chrono::system_clock::now();
-        auto frame_time = now - frame_start;
-        std::this_thread::sleep_for(std::chrono::duration<float>(1.0f / framerate) - frame_time);
-    }
+    SDL_ShowCursor(SDL_DISABLE);
 
-    return index_;
+    pacer_.reset(*window_, *renderer_);
+    compose_rows_ = SDL_RenderTargetSupported(*renderer_);
+
+    repack();
+
+    // discard any input that was meant for the launched app
+    SDL_PumpEvents();
+    SDL_FlushEvents(SDL_KEYDOWN, SDL_KEYUP);
+    SDL_FlushEvents(SDL_JOYAXISMOTION, SDL_JOYBUTTONUP);
+    SDL_FlushEvents(SDL_CONTROLLERAXISMOTION, SDL_CONTROLLERBUTTONUP);
+    SDL_FlushEvent(cec_event);
+
+    int w, h;
+    SDL_GetRendererOutputSize(*renderer_, &w, &h);
+    resize(w, h);
+
+    present_frame();
 }
 
 void Menu::prev()
@@ -305,8 +593,13 @@ void Menu::prev()
     if(animation_direction_ == 0)
     {
         index_ = index_ == 0 ? static_cast<int>(std::size(apps_)) - 1 : index_ - 1;
-        animation_start_ = std::chrono::system_clock::now();
+        animation_start_ = pacer_.predict_present();
         animation_direction_ = -1;
+        dirty_ = true;
+        if(current_input_)
+            latency_.input(*current_input_);
+        update_residency(animation_direction_);
+        prefetcher_.hover(std::string{apps_[index_].command});
     }
 }
 
@@ -315,8 +608,13 @@ void Menu::next()
     if(animation_direction_ == 0)
     {
         index_ = index_ == static_cast<int>(std::size(apps_)) - 1 ? 0 : index_ + 1;
-        animation_start_ = std::chrono::system_clock::now();
+        animation_start_ = pacer_.predict_present();
         animation_direction_ = 1;
+        dirty_ = true;
+        if(current_input_)
+            latency_.input(*current_input_);
+        update_residency(animation_direction_);
+        prefetcher_.hover(std::string{apps_[index_].command});
     }
 }
 
@@ -335,78 +633,546 @@ void Menu::queue_cec_event(CEC::cec_user_control_code code)
     SDL_PushEvent(&ev);
 }
 
+// Note - this is not going to be called from the main thread
+void Menu::queue_decode_event()
+{
+    SDL_Event ev;
+    SDL_zero(ev);
+    ev.type = decode_event;
+    SDL_PushEvent(&ev);
+}
+
+// Note - this is not going to be called from the main thread
+void Menu::queue_latency_report_event()
+{
+    SDL_Event ev;
+    SDL_zero(ev);
+    ev.type = latency_event;
+    SDL_PushEvent(&ev);
+}
+
+// Note - this is not going to be called from the main thread
+void Menu::queue_reload_event()
+{
+    SDL_Event ev;
+    SDL_zero(ev);
+    ev.type = reload_event;
+    SDL_PushEvent(&ev);
+}
+
+// Note - this is not going to be called from the main thread
+void Menu::queue_child_event()
+{
+    SDL_Event ev;
+    SDL_zero(ev);
+    ev.type = child_event;
+    SDL_PushEvent(&ev);
+}
+
+void Menu::report_children()
+{
+    for(auto & child: children_.collect())
+        child.report(std::cout);
+}
+
+void Menu::upload_thumbnails()
+{
+    auto results = decode_pool_.collect();
+    for(auto && result: results)
+    {
+        auto row = app_textures_.find(result.id);
+        if(row == std::end(app_textures_)) // scrolled out of residency while decoding
+            continue;
+
+        auto & tex = row->second;
+        tex.thumbnail_pending = false;
+        tex.thumbnail_evicted = false;
+        tex.composed = {};
+        dirty_ = true;
+
+        if(result.decoded)
+        {
+            tex.thumbnail = SDL::Texture{*renderer_, std::move(*result.decoded), std::string{apps_[result.id].thumbnail_path}, &thumbnail_cache_};
+            tex.thumbnail.account(texture_memory_, Texture_memory::Category::THUMBNAIL);
+            pack(tex.thumbnail);
+        }
+        else
+            std::cerr<<"Error loading thumbnail "<<apps_[result.id].thumbnail_path<<": "<<result.error<<'\n';
+    }
+
+    enforce_texture_budget();
+    check_populated();
+}
+
 void Menu::resize(int w, int h)
 {
     if(w != w_ || h != h_)
     {
+        auto resize_start = Frame_pacer::clock::now();
+
         w_ = w; h_ = h;
+        dirty_ = true;
 
-        const auto font_size = h_ / 20;
+        // may have moved to a different display mode
+        pacer_.reset(*window_, *renderer_);
 
-        auto title_font = SDL::Font{"sans-serif", font_size};
-        auto desc_font = SDL::Font{"sans-serif", font_size / 2};
+        const auto font_size = h_ / 20;
 
-        auto layout = Layout{w_, h_};
-        for(auto i = 0u; i < std::size(apps_); ++i)
+        title_font_ = SDL::Font{"sans-serif", font_size};
+        desc_font_ = SDL::Font{"sans-serif", font_size / 2};
+
+        // Everything resident was built for the old size. Rebuild the window, and drop the pool rather than rebuilding it.
+        // Only the selected row is rebuilt now. The rest of the window and the input icons follow, a piece per frame
+        // (see populate_step), and thumbnails as they're decoded
+        decode_pool_.cancel();
+        atlas_.clear();
+        atlas_overflowed_ = false;
+        clear_composed_rows();
+        for(auto row: residency_.update(index_, 0).unload)
+            app_textures_.erase(row);
+        for(auto row: residency_.clear_pool())
+            app_textures_.erase(row);
+
+        // Their text points into the old fonts' glyphs, which are gone. Drop it now; draw_row skips them until rebuilt
+        pending_rows_.assign(std::begin(residency_.get_window()), std::end(residency_.get_window()));
+        for(auto row: pending_rows_)
         {
-            if(!apps_[i].thumbnail_path.empty())
+            if(auto found = app_textures_.find(row); found != std::end(app_textures_))
             {
-                if(app_textures_[i].thumbnail)
-                    app_textures_[i].thumbnail.rescale(renderer_, layout.image_size_px(), layout.image_size_px());
-                else
-                    app_textures_[i].thumbnail = SDL::Texture{renderer_, apps_[i].thumbnail_path, layout.image_size_px(), layout.image_size_px()};
+                auto & tex = found->second;
+                tex.title = tex.desc = tex.note = SDL::Text{};
+                tex.composed = {};
             }
+        }
+        load_row(index_);
+        icons_pending_ = true;
+        populated_ = false;
 
-            if(!apps_[i].title.empty())
-                app_textures_[i].title = title_font.render_text(renderer_, apps_[i].title, text_color, layout.text_wrap_px());
-            if(!apps_[i].desc.empty())
-                app_textures_[i].desc = desc_font.render_text(renderer_, apps_[i].desc, text_color, layout.text_wrap_px());
-            if(!apps_[i].note.empty())
-                app_textures_[i].note = desc_font.render_text(renderer_, apps_[i].note, text_color, layout.text_wrap_px());
+        if(timings_)
+            timings_->resizes.push_back(Frame_pacer::clock::now() - resize_start);
+    }
+}
+
+void Menu::watch_files()
+{
+    auto paths = app_list_.get_sources();
+    for(auto & app: apps_)
+    {
+        if(!app.thumbnail_path.empty())
+            paths.emplace_back(app.thumbnail_path);
+    }
+    file_watcher_.watch(paths);
+}
+
+void Menu::reload_files()
+{
+    auto changed = file_watcher_.take_changes();
+    if(std::empty(changed))
+        return;
+
+    const auto & sources = app_list_.get_sources();
+    if(std::any_of(std::begin(sources), std::end(sources), [&changed](const auto & s) { return changed.count(s); }))
+    {
+        try
+        {
+            reload_app_list(read_app_list(app_list_.get_path()));
+        }
+        catch(const std::runtime_error & e)
+        {
+            std::cerr<<"Error reloading app list: "<<e.what()<<". Keeping the current one\n";
         }
+        watch_files();
+    }
+
+    if(w_ == 0 || h_ == 0)
+        return;
 
-        mouse_icon_.rescale(renderer_, layout.input_icon_size_px(), layout.input_icon_size_px());
-        keyboard_icon_.rescale(renderer_, layout.input_icon_size_px(), layout.input_icon_size_px());
-        gamepad_icon_.rescale(renderer_, layout.input_icon_size_px(), layout.input_icon_size_px());
-        cec_icon_.rescale(renderer_, layout.input_icon_size_px(), layout.input_icon_size_px());
+    // the image cache is keyed by mtime, so a changed thumbnail is decoded again. A file edited in place may have been
+    // mid-decode: that decode only reads a snapshot (see decode_image), and its result is dropped for this one's
+    for(auto & [row, tex]: app_textures_)
+    {
+        if(changed.count(std::string{apps_[row].thumbnail_path}))
+        {
+            tex.thumbnail = SDL::Texture{};
+            load_thumbnail(row);
+            dirty_ = true;
+        }
     }
 }
 
-void Menu::draw()
+// Keep the textures of resident rows that are unchanged in the new list (wherever they moved to), and the selection
+void Menu::reload_app_list(App_list && new_list)
 {
+    const auto & new_apps = new_list.get_apps();
+
+    auto resident = std::unordered_multimap<std::string_view, std::size_t>{};
+    for(auto & [row, tex]: app_textures_)
+        resident.emplace(apps_[row].title, row);
+
+    auto reused = std::unordered_map<std::size_t, std::size_t>{}; // new row -> old row
+    for(auto i = std::size_t{0}; i < std::size(new_apps); ++i)
+    {
+        auto [begin, end] = resident.equal_range(new_apps[i].title);
+        auto match = std::find_if(begin, end, [this, &new_apps, i](const auto & r) { return apps_[r.second] == new_apps[i]; });
+        if(match != end)
+        {
+            reused.emplace(i, match->second);
+            resident.erase(match);
+        }
+    }
+
+    // nearest copy of the selected app, or else the same position
+    auto new_index = std::min(index_, static_cast<int>(std::size(new_apps)) - 1);
+    auto best_distance = std::numeric_limits<int>::max();
+    for(auto i = 0; i < static_cast<int>(std::size(new_apps)); ++i)
+    {
+        if(new_apps[i] == apps_[index_] && std::abs(i - index_) < best_distance)
+        {
+            new_index = i;
+            best_distance = std::abs(i - index_);
+        }
+    }
+
+    // rows being decoded may be about to change index
+    decode_pool_.cancel();
+    auto old_textures = std::exchange(app_textures_, {});
+    auto old_pending = std::exchange(pending_rows_, {});
+
+    app_list_ = std::move(new_list);
+    index_ = new_index;
+    dirty_ = true;
+    prefetcher_.hover(std::string{apps_[index_].command});
+
+    residency_.reset(std::size(apps_));
+    auto update = residency_.update(index_, 0);
     if(w_ == 0 || h_ == 0)
         return;
 
-    draw_row(-1);
-    draw_row(0);
-    draw_row(1);
+    auto kept = 0;
+    for(auto row: update.load)
+    {
+        auto old_row = reused.find(row);
+        if(old_row == std::end(reused))
+        {
+            load_row(row);
+            continue;
+        }
 
-    if(animation_direction_ < 0)
-        draw_row(2);
-    else if(animation_direction_ > 0)
-        draw_row(-2);
+        // not yet rebuilt after a resize
+        if(std::find(std::begin(old_pending), std::end(old_pending), old_row->second) != std::end(old_pending))
+        {
+            pending_rows_.push_back(row);
+            continue;
+        }
+
+        auto & tex = app_textures_[row] = std::move(old_textures[old_row->second]);
+        if(tex.thumbnail_pending)
+            load_thumbnail(row);
+        ++kept;
+    }
+    enforce_texture_budget();
+
+    std::cout<<"App list reloaded: "<<std::size(apps_)<<" apps, "<<kept<<" rows kept, "<<std::size(update.load) - kept<<" rebuilt\n";
 }
 
-void Menu::draw_row(int pos)
+void Menu::update_residency(int direction)
 {
-    auto animation_offset = 0;
-    auto layout = Layout(w_, h_);
+    auto update = residency_.update(index_, direction);
+
+    for(auto row: update.unload)
+        app_textures_.erase(row);
+
+    // only rows that can be on screen keep their composed copy
+    for(auto && [row, tex]: app_textures_)
+    {
+        if(distance(row) > 2)
+            tex.composed = {};
+    }
+
+    if(w_ == 0 || h_ == 0) // nothing can be built until the first resize
+        return;
+
+    for(auto row: update.load)
+        load_row(row);
+
+    // bring back anything the budget evicted that's about to be drawn
+    const auto num_apps = static_cast<int>(std::size(apps_));
+    for(auto pos = -2; pos <= 2; ++pos)
+    {
+        auto row = app_textures_.find(((index_ + pos) % num_apps + num_apps) % num_apps);
+        if(row != std::end(app_textures_) && row->second.thumbnail_evicted && !row->second.thumbnail_pending)
+            load_thumbnail(row->first);
+    }
+
+    enforce_texture_budget();
+}
 
+void Menu::load_row(std::size_t row)
+{
+    // may have been waiting for populate_step
+    std::erase(pending_rows_, row);
+
+    load_thumbnail(row);
+    load_text(row);
+    pack(app_textures_[row].thumbnail);
+}
+
+void Menu::load_text(std::size_t row)
+{
+    auto layout = Layout{w_, h_};
+    auto & app = apps_[row];
+    auto & tex = app_textures_[row];
+    tex.composed = {};
+
+    // glyphs are shared by every row using the same font, and live as long as it does
+    auto new_glyph = [this](SDL::Texture & glyph)
+    {
+        glyph.account(texture_memory_, Texture_memory::Category::TEXT);
+        pack(glyph);
+    };
+
+    // even when empty, so that has_current_text can tell these apart from text laid out by a replaced font
+    tex.title = title_font_.layout_text(*renderer_, app.title, layout.text_wrap_px(), new_glyph);
+    tex.desc = desc_font_.layout_text(*renderer_, app.desc, layout.text_wrap_px(), new_glyph);
+    tex.note = desc_font_.layout_text(*renderer_, app.note, layout.text_wrap_px(), new_glyph);
+}
+
+// Text points into the glyphs of the font that laid it out, which resize() replaces
+bool Menu::has_current_text(const Menu_textures & tex) const
+{
+    return title_font_.is_current(tex.title) && desc_font_.is_current(tex.desc) && desc_font_.is_current(tex.note);
+}
+
+void Menu::load_icons()
+{
+    auto layout = Layout{w_, h_};
+    auto load_icon = [this, &layout](SDL::Texture & icon, char * start, char * end)
+    {
+        icon = SDL::Texture{*renderer_, std::span{start, static_cast<std::size_t>(end - start)}, layout.input_icon_size_px(), layout.input_icon_size_px()};
+        icon.account(texture_memory_, Texture_memory::Category::ICON);
+        pack(icon);
+    };
+
+    load_icon(mouse_icon_, _binary_computer_mouse_svg_start, _binary_computer_mouse_svg_end);
+    load_icon(keyboard_icon_, _binary_keyboard_svg_start, _binary_keyboard_svg_end);
+    load_icon(gamepad_icon_, _binary_gamepad_svg_start, _binary_gamepad_svg_end);
+    load_icon(cec_icon_, _binary_mobile_retro_svg_start, _binary_mobile_retro_svg_end);
+
+    clear_composed_rows();
+}
+
+// One piece of what resize() left for later: the next nearest row of the window, then the input icons
+void Menu::populate_step()
+{
+    if(w_ == 0 || h_ == 0)
+        return;
+
+    if(!std::empty(pending_rows_))
+    {
+        auto row = pending_rows_.front();
+        pending_rows_.pop_front();
+
+        // may have scrolled away since
+        if(residency_.is_resident(row))
+            load_row(row);
+    }
+    else if(icons_pending_)
+    {
+        load_icons();
+        icons_pending_ = false;
+    }
+
+    enforce_texture_budget();
+    dirty_ = true;
+    check_populated();
+}
+
+void Menu::check_populated()
+{
+    if(populated_ || !std::empty(pending_rows_) || icons_pending_
+            || std::any_of(std::begin(app_textures_), std::end(app_textures_), [](const auto & t) { return t.second.thumbnail_pending; }))
+        return;
+
+    populated_ = true;
+
+    // only interesting the first time, when it's the startup time
+    if(std::exchange(first_populate_, false))
+    {
+        auto now = Frame_pacer::clock::now();
+        std::cout<<"Fully populated after "<<std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(now - start_time_).count()<<" ms\n";
+        if(thumbnail_cache_.enabled())
+            std::cout<<"Thumbnail cache: "<<thumbnail_cache_.get_hits()<<" hits, "<<thumbnail_cache_.get_misses()<<" misses\n";
+        if(timings_)
+            timings_->fully_populated = now;
+    }
+}
+
+void Menu::load_thumbnail(std::size_t row)
+{
+    auto layout = Layout{w_, h_};
+    auto & app = apps_[row];
+    auto & tex = app_textures_[row];
+
+    // Thumbnails are decoded in the background. Until the new one arrives, the old texture (if any) is stretched to fit,
+    // otherwise a placeholder is drawn
+    tex.composed = {};
+    tex.thumbnail_pending = false;
+    tex.thumbnail_evicted = false;
+    if(!app.thumbnail_path.empty() && (!tex.thumbnail || tex.thumbnail.is_rescalable()))
+    {
+        tex.thumbnail_pending = true;
+        decode_pool_.submit(row, std::string{app.thumbnail_path}, layout.image_size_px(), layout.image_size_px());
+    }
+}
+
+// how many rows away from the selection, in whichever direction is shorter
+int Menu::distance(std::size_t row) const
+{
+    const auto num_apps = static_cast<int>(std::size(apps_));
+    auto d = std::abs(static_cast<int>(row) - index_) % num_apps;
+    return std::min(d, num_apps - d);
+}
+
+// When over budget, first reduce thumbnails to the resolution they're drawn at, then drop the ones that aren't on
+// screen. Either way, farthest from the selection first. If dropping every off screen thumbnail still wouldn't get under
+// budget (as when the atlas pages alone use most of it), none are dropped: they'd only be reloaded as soon as they came
+// back into the residency window, and then dropped again
+void Menu::enforce_texture_budget()
+{
+    if(!texture_memory_.over_budget())
+        return;
+
+    auto rows = std::vector<std::size_t>{};
+    for(auto && [row, tex]: app_textures_)
+    {
+        if(tex.thumbnail)
+            rows.push_back(row);
+    }
+    std::sort(std::begin(rows), std::end(rows), [this](auto a, auto b) { return distance(a) > distance(b); });
+
+    auto layout = Layout{w_, h_};
+    auto downscaled = 0, evicted = 0;
+
+    for(auto row: rows)
+    {
+        if(!texture_memory_.over_budget())
+            break;
+
+        auto & thumbnail = app_textures_[row].thumbnail;
+        if(thumbnail.downscale(*renderer_, layout.image_size_px(), layout.image_size_px()))
+        {
+            pack(thumbnail);
+            ++downscaled;
+        }
+    }
+
+    // rows within 2 of the selection can be on screen
+    auto evictable = std::size_t{0};
+    for(auto row: rows)
+    {
+        if(distance(row) > 2)
+            evictable += app_textures_[row].thumbnail.get_bytes();
+    }
+
+    if(texture_memory_.get_used() - std::min(evictable, texture_memory_.get_used()) <= texture_memory_.get_budget())
+    {
+        for(auto row: rows)
+        {
+            if(!texture_memory_.over_budget() || distance(row) <= 2)
+                break;
+
+            auto & tex = app_textures_[row];
+            tex.thumbnail = SDL::Texture{};
+            tex.thumbnail_evicted = true;
+            tex.composed = {};
+            ++evicted;
+        }
+    }
+
+    if(downscaled || evicted)
+    {
+        std::cout<<"Texture memory over budget: downscaled "<<downscaled<<" and evicted "<<evicted<<" thumbnails, now using "
+                 <<texture_memory_.get_used() / 1024<<" of "<<texture_memory_.get_budget() / 1024<<" KiB\n";
+    }
+}
+
+void Menu::for_each_texture(const std::function<void(SDL::Texture &)> & f)
+{
+    for(auto & [row, tex]: app_textures_)
+        f(tex.thumbnail);
+
+    title_font_.for_each_glyph(f);
+    desc_font_.for_each_glyph(f);
+
+    f(mouse_icon_);
+    f(keyboard_icon_);
+    f(gamepad_icon_);
+    f(cec_icon_);
+}
+
+void Menu::pack(SDL::Texture & texture)
+{
+    if(!texture || texture.pack(*renderer_, atlas_) || atlas_overflowed_ || !atlas_.fits(texture.get_image()))
+        return;
+
+    // Out of room. Space used by rows that have since been unloaded isn't reclaimed individually, so start over with
+    // only what's still resident. If even that doesn't fit, the rest stay in their own textures until the next resize
+    repack();
+}
+
+void Menu::repack()
+{
+    atlas_.clear();
+    atlas_overflowed_ = false;
+
+    for_each_texture([this](SDL::Texture & t)
+    {
+        if(t && !t.pack(*renderer_, atlas_) && atlas_.fits(t.get_image()))
+            atlas_overflowed_ = true;
+    });
+}
+
+void Menu::draw()
+{
+    if(w_ == 0 || h_ == 0)
+        return;
+
+    // Time the animation against when this frame will be on screen, so that the motion is even at any refresh rate
+    auto animation_offset = 0;
     if(animation_direction_ != 0)
     {
-        auto animation_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - animation_start_);
+        auto animation_time = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(pacer_.predict_present() - animation_start_);
         if(animation_time >= animation_duration)
         {
             animation_direction_ = 0;
         }
         else
         {
-            auto percentage = static_cast<float>(animation_time.count()) / animation_duration.count();
+            auto layout = Layout{w_, h_};
+            auto percentage = std::max(0.0f, animation_time.count() / animation_duration.count());
             auto start = (layout.row_height_px() + layout.row_spacing_px()) * animation_direction_;
             animation_offset = static_cast<int>((1.0f - percentage) * start);
         }
     }
 
+    batch_.clear();
+
+    draw_row(-1, animation_offset);
+    draw_row(0, animation_offset);
+    draw_row(1, animation_offset);
+
+    if(animation_direction_ < 0)
+        draw_row(2, animation_offset);
+    else if(animation_direction_ > 0)
+        draw_row(-2, animation_offset);
+
+    batch_.draw(*renderer_);
+}
+
+void Menu::draw_row(int pos, int animation_offset)
+{
+    auto layout = Layout(w_, h_);
+
     const auto row_top_px = h_ / 2 + pos * (layout.row_height_px() + layout.row_spacing_px()) - layout.row_height_px() / 2 + animation_offset;
 
     auto row_index = index_ + pos;
@@ -416,46 +1182,110 @@ void Menu::draw_row(int pos)
     while(row_index < 0)
         row_index += std::size(apps_);
 
-    auto & tex = app_textures_[row_index];
+    // not built yet, or not rebuilt since the fonts changed
+    auto row = app_textures_.find(row_index);
+    if(row == std::end(app_textures_) || !has_current_text(row->second))
+        return;
+    auto & tex = row->second;
+
+    const auto fade = static_cast<Uint8>(pos == 0 ? 255 : 64);
 
-    const auto fade = pos == 0 ? 255 : 64;
-    SDL_SetTextureColorMod(tex.thumbnail, fade, fade, fade);
-    SDL_SetTextureColorMod(tex.title, fade, fade, fade);
-    SDL_SetTextureColorMod(tex.desc, fade, fade, fade);
-    SDL_SetTextureColorMod(tex.note, fade, fade, fade);
-    SDL_SetTextureColorMod(mouse_icon_, fade, fade, fade);
-    SDL_SetTextureColorMod(keyboard_icon_, fade, fade, fade);
-    SDL_SetTextureColorMod(gamepad_icon_, fade, fade, fade);
-    SDL_SetTextureColorMod(cec_icon_, fade, fade, fade);
+    // A row's content only changes when part of it is (re)loaded, so rather than drawing each piece every frame of the
+    // scroll animation, draw it once into its own texture and draw that as one quad
+    if(compose_rows_ && !tex.composed)
+        compose_row(row_index, tex);
 
-    tex.thumbnail.render(renderer_, layout.horiz_margin_px(), row_top_px, layout.image_size_px(), layout.image_size_px());
-    tex.title.render(renderer_, layout.text_x_px(), row_top_px);
-    tex.desc.render(renderer_, layout.text_x_px(), row_top_px + tex.title.get_height());
-    tex.note.render(renderer_, layout.text_x_px(), row_top_px + tex.title.get_height() + tex.desc.get_height());
+    if(tex.composed)
+        tex.composed.render(batch_, SDL_Color{fade, fade, fade, 0xFF}, layout.horiz_margin_px(), row_top_px);
+    else
+        add_row(batch_, row_index, tex, layout.horiz_margin_px(), row_top_px, fade);
+}
 
-    auto & app = apps_[row_index];
+// Add a row's thumbnail, text, and input icons to batch, with the row's top left at x, y.
+// Returns the size of what was added, from x, y
+SDL_Point Menu::add_row(SDL::Batch & batch, std::size_t row, Menu_textures & tex, int x, int y, Uint8 fade)
+{
+    auto layout = Layout(w_, h_);
+    auto size = SDL_Point{0, 0};
+    auto extend = [&size, x, y](int right, int bottom)
+    {
+        size.x = std::max(size.x, right - x);
+        size.y = std::max(size.y, bottom - y);
+    };
 
-    auto input_icon_x = layout.text_x_px() + tex.note.get_width() + layout.input_icon_margin_px();
-    auto input_icon_y = row_top_px + tex.title.get_height() + tex.desc.get_height();
+    const auto color = SDL_Color{fade, fade, fade, 0xFF};
 
-    if(app.input_mouse)
+    if(tex.thumbnail)
     {
-        mouse_icon_.render(renderer_, input_icon_x, input_icon_y, layout.input_icon_size_px(), layout.input_icon_size_px());
-        input_icon_x += layout.input_icon_size_px() + layout.input_icon_margin_px();
+        tex.thumbnail.render(batch, color, x, y, layout.image_size_px(), layout.image_size_px());
+        extend(x + layout.image_size_px(), y + layout.image_size_px());
     }
-    if(app.input_keyboard)
+    else if(tex.thumbnail_pending)
     {
-        keyboard_icon_.render(renderer_, input_icon_x, input_icon_y, layout.input_icon_size_px(), layout.input_icon_size_px());
-        input_icon_x += layout.input_icon_size_px() + layout.input_icon_margin_px();
+        auto placeholder = SDL_Rect{x, y, layout.image_size_px(), layout.image_size_px()};
+        batch.add_fill(placeholder, SDL_Color{static_cast<Uint8>(placeholder_color.r * fade / 255), static_cast<Uint8>(placeholder_color.g * fade / 255),
+                static_cast<Uint8>(placeholder_color.b * fade / 255), placeholder_color.a});
+        extend(x + layout.image_size_px(), y + layout.image_size_px());
     }
-    if(app.input_gamepad)
+
+    const auto text_x = x + layout.text_x_px() - layout.horiz_margin_px();
+    const auto text_tint = SDL_Color{static_cast<Uint8>(text_color.r * fade / 255), static_cast<Uint8>(text_color.g * fade / 255),
+            static_cast<Uint8>(text_color.b * fade / 255), text_color.a};
+    tex.title.render(batch, text_tint, text_x, y);
+    tex.desc.render(batch, text_tint, text_x, y + tex.title.get_height());
+    tex.note.render(batch, text_tint, text_x, y + tex.title.get_height() + tex.desc.get_height());
+    extend(text_x + std::max({tex.title.get_width(), tex.desc.get_width(), tex.note.get_width()}),
+            y + tex.title.get_height() + tex.desc.get_height() + tex.note.get_height());
+
+    auto & app = apps_[row];
+
+    auto input_icon_x = text_x + tex.note.get_width() + layout.input_icon_margin_px();
+    auto input_icon_y = y + tex.title.get_height() + tex.desc.get_height();
+
+    auto add_icon = [&](SDL::Texture & icon)
     {
-        gamepad_icon_.render(renderer_, input_icon_x, input_icon_y, layout.input_icon_size_px(), layout.input_icon_size_px());
+        icon.render(batch, color, input_icon_x, input_icon_y, layout.input_icon_size_px(), layout.input_icon_size_px());
+        extend(input_icon_x + layout.input_icon_size_px(), input_icon_y + layout.input_icon_size_px());
         input_icon_x += layout.input_icon_size_px() + layout.input_icon_margin_px();
-    }
+    };
+
+    if(app.input_mouse)
+        add_icon(mouse_icon_);
+    if(app.input_keyboard)
+        add_icon(keyboard_icon_);
+    if(app.input_gamepad)
+        add_icon(gamepad_icon_);
     if(app.input_cec)
+        add_icon(cec_icon_);
+
+    return size;
+}
+
+// Compose at full brightness, so the row can be faded by tinting the result. If the renderer turns out not to be able
+// to, rows are drawn directly from then on
+void Menu::compose_row(std::size_t row, Menu_textures & tex)
+{
+    compose_batch_.clear();
+    auto size = add_row(compose_batch_, row, tex, 0, 0, 255);
+    if(size.x <= 0 || size.y <= 0)
+        return;
+
+    try
     {
-        cec_icon_.render(renderer_, input_icon_x, input_icon_y, layout.input_icon_size_px(), layout.input_icon_size_px());
-        input_icon_x += layout.input_icon_size_px() + layout.input_icon_margin_px();
+        tex.composed = SDL::Render_target{*renderer_, size.x, size.y};
+        tex.composed.account(texture_memory_, Texture_memory::Category::ROW);
+        tex.composed.compose(*renderer_, compose_batch_);
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<", menu rows will be drawn directly\n";
+        tex.composed = {};
+        compose_rows_ = false;
     }
 }
+
+void Menu::clear_composed_rows()
+{
+    for(auto && [row, tex]: app_textures_)
+        tex.composed = {};
+}
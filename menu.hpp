@@ -2,41 +2,121 @@
 #define MENU_HPP
 
 #include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
 #include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include "app.hpp"
 #include "cec.hpp"
+#include "decode_pool.hpp"
+#include "fbdev.hpp"
+#include "file_watcher.hpp"
 #include "font.hpp"
+#include "frame_pacer.hpp"
+#include "image_cache.hpp"
 #include "joystick.hpp"
+#include "latency.hpp"
+#include "launcher.hpp"
+#include "prefetch.hpp"
+#include "residency.hpp"
 #include "sdl.hpp"
 #include "texture.hpp"
+#include "texture_memory.hpp"
 
 class Menu
 {
 public:
-    Menu(const std::vector<App> & apps, bool allow_escape, int start_index = -1, const std::string & ctrl_alt_del_cmd = std::string{});
+    // app_list is watched for changes, and reloaded in place. If fbdev has a path, frames are drawn by the CPU and
+    // copied there, rather than presented through SDL
+    Menu(App_list & app_list, bool allow_escape, int start_index = -1, const std::string & ctrl_alt_del_cmd = std::string{},
+            unsigned int decode_threads = 0, int residency_window = 8, bool measure_latency = false, std::size_t texture_budget = 0,
+            const Fb_config & fbdev = {});
     int run();
     int get_exited() const { return exited_; }
 
+    // passes through the event loop that did / didn't need to draw anything
+    std::uint64_t get_frames_rendered() const { return frames_rendered_; }
+    std::uint64_t get_frames_skipped() const { return frames_skipped_; }
+
+    // print input to present latency percentiles, if measure_latency was set. Also printed on SIGUSR1
+    void report_latency() const { latency_.report(std::cout); }
+
+    // bytes copied to the framebuffer since the last resume(), if drawing to one
+    std::uint64_t get_fb_bytes_written() const { return fb_ ? fb_->get_bytes_written() : 0; }
+
+    // per category texture memory use and peaks
+    void report_texture_memory() const { texture_memory_.report(std::cout); }
+
+    // For benchmarking: how long resize() and each frame (clear, draw, and present) take
+    struct Timings
+    {
+        Frame_pacer::clock::time_point first_present {};
+        Frame_pacer::clock::time_point fully_populated {}; // every row in the window built, thumbnails decoded, and icons loaded
+        std::vector<Frame_pacer::clock::duration> resizes;
+        std::vector<Frame_pacer::clock::duration> frames;
+    };
+    void record_timings(Timings * timings) { timings_ = timings; }
+
+    // Called from run() each time it's about to wait for events with nothing animating. For scripting input
+    void register_idle_callback(std::function<void(SDL_Window *)> f) { idle_callback_ = std::move(f); }
+
+    // release the display for a launched app, keeping textures' pixel data, CEC, and joysticks
+    void suspend();
+    // re-acquire the display and present a frame
+    void resume();
+
 private:
-    const std::vector<App> & apps_;
+    App_list & app_list_;
+    const std::vector<App> & apps_; // app_list_'s, which stays the same object when the list is reloaded
 
     bool allow_escape_ {false};
     std::string ctrl_alt_del_cmd_{};
+    Fb_config fbdev_config_{};
     bool running_ {false};
     bool exited_ {false};
     int index_ {0};
 
-    std::chrono::system_clock::time_point animation_start_ {};
+    bool dirty_ {true};
+    bool animation_tick_ {false};
+    std::uint64_t frames_rendered_ {0};
+    std::uint64_t frames_skipped_ {0};
+    Timings * timings_ {nullptr};
+    const Frame_pacer::clock::time_point start_time_ {Frame_pacer::clock::now()};
+    std::function<void(SDL_Window *)> idle_callback_ = [](SDL_Window *){};
+
+    Frame_pacer::clock::time_point animation_start_ {};
     int animation_direction_ {0};
 
     int w_{0}, h_{0};
 
-    SDL::SDL sdl_lib_{SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER};
+    SDL::SDL sdl_lib_{SDL_INIT_GAMECONTROLLER};
     SDL::TTF ttf_lib_;
-    SDL::Window window_{"fb_launcher"};
-    SDL::Renderer renderer_{window_};
+    std::optional<SDL::Subsystem> video_{std::in_place, SDL_INIT_VIDEO};
+    std::optional<SDL::Window> window_{std::in_place, "fb_launcher"};
+    // only with an fbdev path. The window is still needed for input
+    std::optional<Fb_output> fb_;
+    std::optional<SDL::Renderer> renderer_;
+    Frame_pacer pacer_;
+    Latency_tracker latency_;
+    // the input event currently being handled, for latency_
+    std::optional<Latency_tracker::Input> current_input_;
+    // must outlive every texture, and the atlas
+    Texture_memory texture_memory_;
+    SDL::Atlas atlas_;
+    bool atlas_overflowed_ {false};
+    SDL::Batch batch_;
+    // off if the renderer can't render to textures, in which case rows are drawn piece by piece every frame
+    bool compose_rows_ {false};
+    SDL::Batch compose_batch_;
     std::map<int, SDL::Joystick> joysticks;
+    // latest motion event for each (joystick, event type, axis) since the last frame
+    std::map<std::tuple<SDL_JoystickID, Uint32, Uint8>, SDL_Event> pending_axis_motion_;
 
     SDL::Texture mouse_icon_ {};
     SDL::Texture keyboard_icon_ {};
@@ -45,25 +125,86 @@ private:
 
     CEC_Input cec_;
 
+    Image_cache thumbnail_cache_;
+
+    SDL::Font title_font_;
+    SDL::Font desc_font_;
+
     struct Menu_textures
     {
-        SDL::Texture title;
-        SDL::Texture desc;
-        SDL::Texture note;
+        SDL::Text title;
+        SDL::Text desc;
+        SDL::Text note;
         SDL::Texture thumbnail;
+        bool thumbnail_pending {false};
+        bool thumbnail_evicted {false}; // dropped to stay within the texture budget. Reloaded if it gets near the selection
+        // all of the above, composed at full brightness. Only kept near the selection, and reset when any of it changes
+        SDL::Render_target composed;
     };
-    std::vector<Menu_textures> app_textures_;
+    // only rows kept resident by residency_ have textures
+    std::unordered_map<std::size_t, Menu_textures> app_textures_;
+    Residency residency_;
+
+    // what resize() left for populate_step, nearest the selection first
+    std::deque<std::size_t> pending_rows_;
+    bool icons_pending_ {false};
+    bool populate_queued_ {false};
+    bool populated_ {false};
+    bool first_populate_ {true};
+
+    Decode_pool decode_pool_;
+
+    // the app list and its thumbnails
+    File_watcher file_watcher_;
+
+    // ctrl_alt_del_cmd_, which runs alongside the menu
+    Child_supervisor children_;
+
+    // warms up the selected app's files, for when it's launched
+    Prefetcher prefetcher_;
+
+    void handle_event(const SDL_Event & ev);
+    void apply_axis_motion();
 
     void prev();
     void next();
     void select();
 
     void queue_cec_event(CEC::cec_user_control_code code);
+    void queue_decode_event();
+    void queue_latency_report_event();
+    void queue_reload_event();
+    void queue_child_event();
+    void report_children();
+    void upload_thumbnails();
+
+    void watch_files();
+    void reload_files();
+    void reload_app_list(App_list && new_list);
+
+    void create_renderer();
+    void present_frame();
 
     void resize(int w, int h);
+    void update_residency(int direction);
+    void load_row(std::size_t row);
+    void load_text(std::size_t row);
+    bool has_current_text(const Menu_textures & tex) const;
+    void load_thumbnail(std::size_t row);
+    void load_icons();
+    void populate_step();
+    void check_populated();
+    int distance(std::size_t row) const;
+    void enforce_texture_budget();
+    void for_each_texture(const std::function<void(SDL::Texture &)> & f);
+    void pack(SDL::Texture & texture);
+    void repack();
 
     void draw();
-    void draw_row(int pos);
+    void draw_row(int pos, int animation_offset);
+    SDL_Point add_row(SDL::Batch & batch, std::size_t row, Menu_textures & tex, int x, int y, Uint8 fade);
+    void compose_row(std::size_t row, Menu_textures & tex);
+    void clear_composed_rows();
 };
 
 #endif // MENU_HPP
@@ -0,0 +1,85 @@
+#ifndef MMAP_HPP
+#define MMAP_HPP
+
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read-only mapping of a whole file
+class Mmap
+{
+private:
+    void * data_ {nullptr};
+    std::size_t size_ {0};
+
+public:
+    Mmap() = default;
+    explicit Mmap(const std::string & path)
+    {
+        auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            throw std::runtime_error {"Error opening input file: " + path + " - " + std::strerror(errno)};
+
+        struct stat st;
+        if(fstat(fd, &st) < 0)
+        {
+            auto err = errno;
+            close(fd);
+            throw std::runtime_error {"Error reading input file: " + path + " - " + std::strerror(err)};
+        }
+
+        size_ = static_cast<std::size_t>(st.st_size);
+        if(size_ > 0)
+        {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data_ == MAP_FAILED)
+            {
+                auto err = errno;
+                close(fd);
+                data_ = nullptr;
+                throw std::runtime_error {"Error mapping input file: " + path + " - " + std::strerror(err)};
+            }
+        }
+        close(fd);
+    }
+    ~Mmap()
+    {
+        if(data_)
+            munmap(data_, size_);
+    }
+
+    Mmap(const Mmap &) = delete;
+    Mmap &operator=(const Mmap &) = delete;
+
+    Mmap(Mmap && m): data_{m.data_}, size_{m.size_}
+    {
+        m.data_ = nullptr;
+        m.size_ = 0;
+    }
+    Mmap &operator=(Mmap && m)
+    {
+        if(&m != this)
+        {
+            if(data_)
+                munmap(data_, size_);
+            data_ = m.data_;
+            size_ = m.size_;
+            m.data_ = nullptr;
+            m.size_ = 0;
+        }
+        return *this;
+    }
+
+    const unsigned char * data() const { return static_cast<const unsigned char *>(data_); }
+    std::size_t size() const { return size_; }
+};
+
+#endif // MMAP_HPP
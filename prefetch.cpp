@@ -0,0 +1,392 @@
+#include "prefetch.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "file.hpp"
+
+namespace
+{
+    // from linux/ioprio.h, which isn't always installed
+    constexpr auto ioprio_class_shift = 13;
+    constexpr auto ioprio_class_idle = 3;
+    constexpr auto ioprio_who_process = 1;
+
+    std::vector<std::string> split(std::string_view str, char delim)
+    {
+        auto parts = std::vector<std::string>{};
+        for(auto pos = std::size_t{0}; pos <= std::size(str);)
+        {
+            auto end = std::min(str.find(delim, pos), std::size(str));
+            if(end > pos)
+                parts.emplace_back(str.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        return parts;
+    }
+
+    // directories listed in ld.so.conf, following includes
+    void read_ld_so_conf(const std::string & path, std::vector<std::string> & dirs, int depth = 0)
+    {
+        if(depth > 8)
+            return;
+
+        auto in = std::ifstream{path};
+        auto line = std::string{};
+        while(std::getline(in, line))
+        {
+            line = line.substr(0, line.find('#'));
+            auto words = split(line, ' ');
+            if(std::empty(words))
+                continue;
+
+            if(words[0] == "include")
+            {
+                for(auto i = std::size_t{1}; i < std::size(words); ++i)
+                {
+                    auto pattern = words[i][0] == '/' ? words[i] : "/etc/" + words[i];
+                    glob_t g {};
+                    if(glob(pattern.c_str(), 0, nullptr, &g) == 0)
+                    {
+                        for(auto j = std::size_t{0}; j < g.gl_pathc; ++j)
+                            read_ld_so_conf(g.gl_pathv[j], dirs, depth + 1);
+                    }
+                    globfree(&g);
+                }
+            }
+            else if(words[0][0] == '/')
+                dirs.push_back(words[0]);
+        }
+    }
+
+    std::vector<std::string> system_lib_dirs()
+    {
+        auto dirs = std::vector<std::string>{};
+        if(auto ld_path = std::getenv("LD_LIBRARY_PATH"))
+            dirs = split(ld_path, ':');
+        read_ld_so_conf("/etc/ld.so.conf", dirs);
+        for(auto dir: {"/lib", "/usr/lib", "/lib64", "/usr/lib64"})
+            dirs.emplace_back(dir);
+        return dirs;
+    }
+
+    struct Elf_info
+    {
+        unsigned char elf_class {ELFCLASSNONE};
+        std::string interp;
+        std::vector<std::string> needed;
+        std::vector<std::string> search_dirs; // DT_RUNPATH, or DT_RPATH without it, with $ORIGIN expanded
+    };
+
+    // read a T at offset, false if the file isn't long enough
+    template <typename T>
+    bool read_struct(const File & file, std::uint64_t offset, T & out)
+    {
+        return file.read_at(offset, &out, sizeof(out)) == sizeof(out);
+    }
+
+    // a NUL terminated string of at most max_size at offset, or up to the end of the file
+    std::string read_string(const File & file, std::uint64_t offset, std::size_t max_size = 4096)
+    {
+        auto str = std::string(max_size, '\0');
+        str.resize(file.read_at(offset, std::data(str), max_size));
+        str.resize(strnlen(std::data(str), std::size(str)));
+        return str;
+    }
+
+    template <typename Ehdr, typename Phdr, typename Dyn>
+    void read_elf(const File & file, const std::string & path, Elf_info & info)
+    {
+        auto header = Ehdr{};
+        if(!read_struct(file, 0, header))
+            return;
+
+        auto loads = std::vector<Phdr>{};
+        auto dynamic = std::optional<Phdr>{};
+        for(auto i = 0; i < header.e_phnum; ++i)
+        {
+            auto ph = Phdr{};
+            if(!read_struct(file, header.e_phoff + i * sizeof(ph), ph))
+                return;
+            if(ph.p_type == PT_LOAD)
+                loads.push_back(ph);
+            else if(ph.p_type == PT_DYNAMIC)
+                dynamic = ph;
+            else if(ph.p_type == PT_INTERP)
+                info.interp = read_string(file, ph.p_offset, std::min<std::uint64_t>(ph.p_filesz, 4096));
+        }
+
+        if(!dynamic)
+            return;
+
+        auto strtab_addr = std::optional<std::uint64_t>{};
+        auto needed = std::vector<std::uint64_t>{};
+        auto runpath = std::optional<std::uint64_t>{};
+        auto rpath = std::optional<std::uint64_t>{};
+        for(auto i = std::size_t{0}; i < dynamic->p_filesz / sizeof(Dyn); ++i)
+        {
+            auto dyn = Dyn{};
+            if(!read_struct(file, dynamic->p_offset + i * sizeof(dyn), dyn) || dyn.d_tag == DT_NULL)
+                break;
+            else if(dyn.d_tag == DT_NEEDED)
+                needed.push_back(dyn.d_un.d_val);
+            else if(dyn.d_tag == DT_STRTAB)
+                strtab_addr = dyn.d_un.d_ptr;
+            else if(dyn.d_tag == DT_RUNPATH)
+                runpath = dyn.d_un.d_val;
+            else if(dyn.d_tag == DT_RPATH)
+                rpath = dyn.d_un.d_val;
+        }
+        if(!strtab_addr)
+            return;
+
+        // DT_STRTAB is an address. Find where it was loaded from
+        auto strtab = std::optional<std::uint64_t>{};
+        for(auto & load: loads)
+        {
+            if(*strtab_addr >= load.p_vaddr && *strtab_addr < load.p_vaddr + load.p_filesz)
+                strtab = *strtab_addr - load.p_vaddr + load.p_offset;
+        }
+        if(!strtab)
+            return;
+
+        auto get_string = [&](std::uint64_t offset) { return read_string(file, *strtab + offset); };
+
+        for(auto offset: needed)
+            info.needed.push_back(get_string(offset));
+
+        if(auto search = runpath ? runpath : rpath)
+        {
+            auto origin = path.substr(0, path.rfind('/'));
+            for(auto dir: split(get_string(*search), ':'))
+            {
+                for(auto pos = dir.find("$ORIGIN"); pos != std::string::npos; pos = dir.find("$ORIGIN", pos + std::size(origin)))
+                    dir.replace(pos, 7, origin);
+                for(auto pos = dir.find("${ORIGIN}"); pos != std::string::npos; pos = dir.find("${ORIGIN}", pos + std::size(origin)))
+                    dir.replace(pos, 9, origin);
+                info.search_dirs.push_back(dir);
+            }
+        }
+    }
+
+    // nullopt if path isn't an ELF file for this machine (or of elf_class, if given). Binaries may be rebuilt in place
+    // while the launcher runs, so they're read, not mapped
+    std::optional<Elf_info> read_elf(const std::string & path, unsigned char elf_class = ELFCLASSNONE)
+    {
+        try
+        {
+            auto file = File{path};
+            unsigned char ident[EI_NIDENT];
+            if(file.read_at(0, ident, EI_NIDENT) < EI_NIDENT || std::memcmp(ident, ELFMAG, SELFMAG) != 0)
+                return std::nullopt;
+
+            auto info = Elf_info{};
+            info.elf_class = ident[EI_CLASS];
+            const auto native_data = std::endian::native == std::endian::little ? ELFDATA2LSB : ELFDATA2MSB;
+            if(ident[EI_DATA] != native_data || (elf_class != ELFCLASSNONE && info.elf_class != elf_class))
+                return std::nullopt;
+
+            if(info.elf_class == ELFCLASS64)
+                read_elf<Elf64_Ehdr, Elf64_Phdr, Elf64_Dyn>(file, path, info);
+            else if(info.elf_class == ELFCLASS32)
+                read_elf<Elf32_Ehdr, Elf32_Phdr, Elf32_Dyn>(file, path, info);
+            else
+                return std::nullopt;
+
+            return info;
+        }
+        catch(const std::runtime_error &)
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::string find_in_path(const std::string & name)
+    {
+        if(name.find('/') != std::string::npos)
+            return name;
+
+        auto path = std::getenv("PATH");
+        for(auto & dir: split(path ? path : "/usr/local/bin:/usr/bin:/bin", ':'))
+        {
+            auto candidate = dir + "/" + name;
+            if(access(candidate.c_str(), X_OK) == 0)
+                return candidate;
+        }
+        return {};
+    }
+
+    // the program a command runs, skipping leading variable assignments and exec
+    std::string command_executable(const std::string & command)
+    {
+        for(auto & word: split(command, ' '))
+        {
+            if(word == "exec" || word.find('=') < word.find('/'))
+                continue;
+            return find_in_path(word);
+        }
+        return {};
+    }
+}
+
+std::vector<std::string> resolve_command_files(const std::string & command)
+{
+    auto files = std::vector<std::string>{};
+
+    auto exe = command_executable(command);
+    if(exe.empty() || access(exe.c_str(), R_OK) != 0)
+        return files;
+    files.push_back(exe);
+
+    // a script's interpreter is what actually gets loaded
+    if(auto in = std::ifstream{exe}; in.get() == '#' && in.get() == '!')
+    {
+        auto line = std::string{};
+        std::getline(in, line);
+        auto words = split(line, ' ');
+        if(std::empty(words))
+            return files;
+        exe = words[0];
+        if(exe.ends_with("/env") && std::size(words) > 1)
+            exe = find_in_path(words[1]);
+        if(exe.empty() || access(exe.c_str(), R_OK) != 0)
+            return files;
+        files.push_back(exe);
+    }
+
+    auto info = read_elf(exe);
+    if(!info)
+        return files;
+
+    if(!info->interp.empty())
+        files.push_back(info->interp);
+
+    static const auto system_dirs = system_lib_dirs();
+
+    // breadth first through the dependency tree. An executable's RPATH also applies to its libraries
+    auto exe_dirs = info->search_dirs;
+    auto seen = std::unordered_set<std::string>{};
+    if(!info->interp.empty())
+        seen.insert(info->interp.substr(info->interp.rfind('/') + 1)); // libc usually needs the loader too
+    auto queue = std::vector<Elf_info>{std::move(*info)};
+    for(auto i = std::size_t{0}; i < std::size(queue); ++i)
+    {
+        auto dirs = queue[i].search_dirs;
+        dirs.insert(std::end(dirs), std::begin(exe_dirs), std::end(exe_dirs));
+        dirs.insert(std::end(dirs), std::begin(system_dirs), std::end(system_dirs));
+
+        for(auto & lib: std::vector<std::string>{queue[i].needed})
+        {
+            if(!seen.insert(lib).second)
+                continue;
+
+            auto candidates = lib.find('/') != std::string::npos ? std::vector<std::string>{lib} : dirs;
+            for(auto & dir: candidates)
+            {
+                auto path = lib.find('/') != std::string::npos ? lib : dir + "/" + lib;
+                if(auto lib_info = read_elf(path, queue[0].elf_class))
+                {
+                    files.push_back(path);
+                    queue.push_back(std::move(*lib_info));
+                    break;
+                }
+            }
+        }
+    }
+
+    return files;
+}
+
+Prefetcher::Prefetcher(std::chrono::milliseconds delay):
+    delay_{delay},
+    thread_{&Prefetcher::run, this}
+{}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        auto lock = std::scoped_lock{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void Prefetcher::hover(const std::string & command)
+{
+    {
+        auto lock = std::scoped_lock{mutex_};
+        pending_ = command;
+        deadline_ = std::chrono::steady_clock::now() + delay_;
+    }
+    cv_.notify_all();
+}
+
+void Prefetcher::cancel()
+{
+    auto lock = std::scoped_lock{mutex_};
+    pending_.reset();
+}
+
+void Prefetcher::run()
+{
+    // stay out of the way of the menu, and of anything already launched. Both apply to just this thread
+    setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()), 19);
+    syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift);
+
+    while(true)
+    {
+        auto command = std::string{};
+        {
+            auto lock = std::unique_lock{mutex_};
+
+            // wait for a hover to last the whole delay. Another hover pushes the deadline back
+            while(!stopping_ && (!pending_ || std::chrono::steady_clock::now() < deadline_))
+            {
+                if(pending_)
+                    cv_.wait_until(lock, deadline_);
+                else
+                    cv_.wait(lock);
+            }
+            if(stopping_)
+                return;
+
+            command = std::move(*pending_);
+            pending_.reset();
+        }
+
+        // Resolving is the expensive part. Advising already cached pages is cheap, and they may have been evicted
+        // since, so that's done every time. This runs whenever the selection rests, so only failures are logged
+        auto resolved = resolved_.find(command);
+        if(resolved == std::end(resolved_))
+            resolved = resolved_.emplace(command, resolve_command_files(command)).first;
+        for(auto & file: resolved->second)
+        {
+            auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+            {
+                std::cerr<<"Could not prefetch "<<file<<" for "<<command<<": "<<std::strerror(errno)<<'\n';
+                continue;
+            }
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The files exec'ing command will read: its executable (and a script's interpreter), the dynamic loader, and every
+// shared library it needs, found by reading DT_NEEDED entries. Best effort: anything that can't be resolved is left out
+std::vector<std::string> resolve_command_files(const std::string & command);
+
+// Speculatively pulls the selected app's files into the page cache once the selection has rested on it for a while,
+// so launching is quicker from slow storage. Runs on a background thread at idle CPU and I/O priority
+class Prefetcher
+{
+public:
+    explicit Prefetcher(std::chrono::milliseconds delay = std::chrono::milliseconds{500});
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher &) = delete;
+    Prefetcher &operator=(const Prefetcher &) = delete;
+
+    // the selection moved to command
+    void hover(const std::string & command);
+    // forget any hover that hasn't been acted on yet
+    void cancel();
+
+private:
+    std::chrono::milliseconds delay_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ {false};
+    std::optional<std::string> pending_;
+    std::chrono::steady_clock::time_point deadline_ {};
+
+    // command -> resolve_command_files(command). Only touched by the thread
+    std::unordered_map<std::string, std::vector<std::string>> resolved_;
+
+    std::thread thread_;
+
+    void run();
+};
+
+#endif // PREFETCH_HPP
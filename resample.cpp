@@ -0,0 +1,244 @@
+#include "resample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// An RGBA pixel is one vector of 4 floats. SSE2 and NEON are baseline on x86_64 and aarch64, so there's no need to
+// check for them at runtime like swizzle.cpp does for AVX2
+#if defined(__SSE2__)
+#define RESAMPLE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define RESAMPLE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // straight alpha bytes to premultiplied floats, leaving color in [0, 255 * 255]
+    void premultiply_row_scalar(const unsigned char * src, float * dst, int num_pixels)
+    {
+        for(auto i = 0; i < num_pixels; ++i)
+        {
+            const float a = src[i * 4 + 3];
+            dst[i * 4 + 0] = src[i * 4 + 0] * a;
+            dst[i * 4 + 1] = src[i * 4 + 1] * a;
+            dst[i * 4 + 2] = src[i * 4 + 2] * a;
+            dst[i * 4 + 3] = a;
+        }
+    }
+
+    // dst = sum of src pixels * weights
+    void weighted_sum_scalar(const float * src, const float * weights, int num_taps, float * dst)
+    {
+        float px[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for(auto t = 0; t < num_taps; ++t)
+        {
+            for(auto c = 0; c < 4; ++c)
+                px[c] += src[t * 4 + c] * weights[t];
+        }
+        std::copy(px, px + 4, dst);
+    }
+
+    // acc += row * weight, over num_pixels pixels
+    void accumulate_row_scalar(float * acc, const float * row, int num_pixels, float weight)
+    {
+        for(auto i = 0; i < num_pixels * 4; ++i)
+            acc[i] += row[i] * weight;
+    }
+
+#if defined(RESAMPLE_SSE2)
+    void premultiply_row_simd(const unsigned char * src, float * dst, int num_pixels)
+    {
+        const auto color_lanes = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        const auto one_in_alpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+        const auto zero = _mm_setzero_si128();
+        for(auto i = 0; i < num_pixels; ++i)
+        {
+            int bytes;
+            std::memcpy(&bytes, src + i * 4, 4);
+            auto p = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+            // (a, a, a, 1)
+            auto a = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)), color_lanes), one_in_alpha);
+            _mm_storeu_ps(dst + i * 4, _mm_mul_ps(p, a));
+        }
+    }
+
+    void weighted_sum_simd(const float * src, const float * weights, int num_taps, float * dst)
+    {
+        auto px = _mm_setzero_ps();
+        for(auto t = 0; t < num_taps; ++t)
+            px = _mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(src + t * 4), _mm_set1_ps(weights[t])));
+        _mm_storeu_ps(dst, px);
+    }
+
+    void accumulate_row_simd(float * acc, const float * row, int num_pixels, float weight)
+    {
+        const auto w = _mm_set1_ps(weight);
+        for(auto i = 0; i < num_pixels; ++i)
+            _mm_storeu_ps(acc + i * 4, _mm_add_ps(_mm_loadu_ps(acc + i * 4), _mm_mul_ps(_mm_loadu_ps(row + i * 4), w)));
+    }
+#elif defined(RESAMPLE_NEON)
+    void premultiply_row_simd(const unsigned char * src, float * dst, int num_pixels)
+    {
+        for(auto i = 0; i < num_pixels; ++i)
+        {
+            auto p = vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vcreate_u8(
+                static_cast<std::uint64_t>(src[i * 4]) | static_cast<std::uint64_t>(src[i * 4 + 1]) << 8
+                | static_cast<std::uint64_t>(src[i * 4 + 2]) << 16 | static_cast<std::uint64_t>(src[i * 4 + 3]) << 24)))));
+            auto a = vsetq_lane_f32(1.0f, vdupq_n_f32(vgetq_lane_f32(p, 3)), 3);
+            vst1q_f32(dst + i * 4, vmulq_f32(p, a));
+        }
+    }
+
+    // separate multiplies and adds, not vfmaq, to round the same as the scalar path
+    void weighted_sum_simd(const float * src, const float * weights, int num_taps, float * dst)
+    {
+        auto px = vdupq_n_f32(0.0f);
+        for(auto t = 0; t < num_taps; ++t)
+            px = vaddq_f32(px, vmulq_n_f32(vld1q_f32(src + t * 4), weights[t]));
+        vst1q_f32(dst, px);
+    }
+
+    void accumulate_row_simd(float * acc, const float * row, int num_pixels, float weight)
+    {
+        for(auto i = 0; i < num_pixels; ++i)
+            vst1q_f32(acc + i * 4, vaddq_f32(vld1q_f32(acc + i * 4), vmulq_n_f32(vld1q_f32(row + i * 4), weight)));
+    }
+#else
+    // not built. resample_path_supported keeps these from being chosen
+    constexpr auto premultiply_row_simd = premultiply_row_scalar;
+    constexpr auto weighted_sum_simd = weighted_sum_scalar;
+    constexpr auto accumulate_row_simd = accumulate_row_scalar;
+#endif
+}
+
+bool resample_path_supported(Resample_path path)
+{
+#if defined(RESAMPLE_SSE2) || defined(RESAMPLE_NEON)
+    return path == Resample_path::SCALAR || path == Resample_path::SIMD;
+#else
+    return path == Resample_path::SCALAR;
+#endif
+}
+
+Area_resampler::Area_resampler(int src_width, int src_height, int dst_width, int dst_height, unsigned char * dst,
+        Resample_path path):
+    src_width_{src_width}, src_height_{src_height},
+    dst_width_{dst_width}, dst_height_{dst_height},
+    dst_{dst},
+    premultiplied_(static_cast<std::size_t>(src_width) * 4),
+    row_(static_cast<std::size_t>(dst_width) * 4),
+    acc_(static_cast<std::size_t>(dst_width) * 4),
+    y_scale_{static_cast<double>(src_height) / dst_height},
+    simd_{path == Resample_path::SIMD && resample_path_supported(path)}
+{
+    if(dst_width < 1 || dst_height < 1 || dst_width > src_width || dst_height > src_height)
+        throw std::runtime_error{"Invalid resample from " + std::to_string(src_width) + 'x' + std::to_string(src_height)
+            + " to " + std::to_string(dst_width) + 'x' + std::to_string(dst_height)};
+
+    // Output pixel x covers [x * x_scale, (x + 1) * x_scale) of the source row. Since this only shrinks, that's at
+    // most ceil(x_scale) + 1 source pixels
+    const auto x_scale = static_cast<double>(src_width) / dst_width;
+    tap_first_.reserve(dst_width);
+    tap_offset_.reserve(dst_width + 1);
+    tap_offset_.push_back(0);
+    for(auto x = 0; x < dst_width; ++x)
+    {
+        const auto start = x * x_scale;
+        const auto end = std::min(static_cast<double>(src_width), (x + 1) * x_scale);
+        const auto first = static_cast<int>(start);
+        const auto last = std::min(src_width, static_cast<int>(std::ceil(end)));
+
+        tap_first_.push_back(first);
+        auto total = 0.0;
+        for(auto i = first; i < last; ++i)
+        {
+            auto w = std::min(end, i + 1.0) - std::max(start, static_cast<double>(i));
+            tap_weights_.push_back(static_cast<float>(w));
+            total += w;
+        }
+
+        // normalize here, so that rounding in the bounds can't brighten or darken a column
+        for(auto i = static_cast<std::size_t>(tap_offset_.back()); i < std::size(tap_weights_); ++i)
+            tap_weights_[i] = static_cast<float>(tap_weights_[i] / total);
+        tap_offset_.push_back(static_cast<int>(std::size(tap_weights_)));
+    }
+}
+
+void Area_resampler::add_row(const unsigned char * src_row)
+{
+    if(src_y_ >= src_height_)
+        return;
+
+    if(simd_)
+        premultiply_row_simd(src_row, std::data(premultiplied_), src_width_);
+    else
+        premultiply_row_scalar(src_row, std::data(premultiplied_), src_width_);
+
+    // horizontally. Branching per pixel, rather than calling through a pointer, lets the sum be inlined
+    for(auto x = 0; x < dst_width_; ++x)
+    {
+        const auto * src = std::data(premultiplied_) + tap_first_[x] * 4;
+        const auto * weights = std::data(tap_weights_) + tap_offset_[x];
+        const auto num_taps = tap_offset_[x + 1] - tap_offset_[x];
+        if(simd_)
+            weighted_sum_simd(src, weights, num_taps, std::data(row_) + x * 4);
+        else
+            weighted_sum_scalar(src, weights, num_taps, std::data(row_) + x * 4);
+    }
+
+    // then vertically. This source row covers [src_y_, src_y_ + 1), which may straddle two output rows
+    const auto top = static_cast<double>(src_y_);
+    const auto bottom = top + 1.0;
+    while(true)
+    {
+        const auto row_top = dst_y_ * y_scale_;
+        const auto row_bottom = (dst_y_ + 1) * y_scale_;
+
+        if(const auto w = static_cast<float>(std::min(bottom, row_bottom) - std::max(top, row_top)); w > 0.0f)
+        {
+            if(simd_)
+                accumulate_row_simd(std::data(acc_), std::data(row_), dst_width_, w);
+            else
+                accumulate_row_scalar(std::data(acc_), std::data(row_), dst_width_, w);
+            acc_weight_ += w;
+        }
+
+        if(bottom <= row_bottom || dst_y_ + 1 == dst_height_)
+            break;
+
+        emit_row();
+    }
+
+    if(++src_y_ == src_height_)
+        emit_row();
+}
+
+void Area_resampler::emit_row()
+{
+    auto * dst = dst_ + static_cast<std::size_t>(dst_y_) * dst_width_ * 4;
+
+    for(auto x = 0; x < dst_width_; ++x)
+    {
+        const auto * p = std::data(acc_) + x * 4;
+        const auto a = p[3];
+        if(a <= 0.0f)
+        {
+            dst[x * 4 + 0] = dst[x * 4 + 1] = dst[x * 4 + 2] = dst[x * 4 + 3] = 0;
+            continue;
+        }
+
+        // back to straight alpha. The weights cancel out of color, but not alpha
+        for(auto c = 0; c < 3; ++c)
+            dst[x * 4 + c] = static_cast<unsigned char>(std::min(255.0f, p[c] / a + 0.5f));
+        dst[x * 4 + 3] = static_cast<unsigned char>(std::min(255.0f, a / acc_weight_ + 0.5f));
+    }
+
+    std::fill(std::begin(acc_), std::end(acc_), 0.0f);
+    acc_weight_ = 0.0f;
+    ++dst_y_;
+}
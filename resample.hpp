@@ -0,0 +1,53 @@
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include <vector>
+
+// For testing the SIMD path against the scalar one, which it matches bit for bit. SIMD is available wherever it's built
+enum class Resample_path { SCALAR, SIMD };
+bool resample_path_supported(Resample_path path);
+
+// Shrinks an RGBA image with an area (box) filter: each output pixel is the average of the source pixels it covers,
+// weighted by how much of each it covers. Source rows are fed in one at a time, top to bottom, so only one source row
+// and one partly accumulated output row need to be held. Averages in premultiplied alpha, so that transparent pixels
+// don't darken edges, and writes straight alpha.
+// Works in floats, with each pixel's 4 channels in one SSE2 or NEON vector where available
+class Area_resampler
+{
+public:
+    // dst holds dst_width x dst_height RGBA pixels, and each dst dimension must be between 1 and the src one
+    // path falls back to SCALAR if SIMD isn't supported
+    Area_resampler(int src_width, int src_height, int dst_width, int dst_height, unsigned char * dst,
+            Resample_path path = Resample_path::SIMD);
+
+    // the next source row, src_width straight alpha RGBA pixels. dst is complete after src_height calls
+    void add_row(const unsigned char * src_row);
+
+private:
+    int src_width_ {0};
+    int src_height_ {0};
+    int dst_width_ {0};
+    int dst_height_ {0};
+    unsigned char * dst_ {nullptr};
+
+    // source pixels [tap_first_[x], tap_first_[x] + count) contribute to output pixel x, where count is
+    // tap_offset_[x + 1] - tap_offset_[x], with weights from tap_weights_[tap_offset_[x]]
+    std::vector<int> tap_first_;
+    std::vector<int> tap_offset_;
+    std::vector<float> tap_weights_;
+
+    std::vector<float> premultiplied_; // the current source row
+    std::vector<float> row_;           // the current source row, resampled horizontally
+    std::vector<float> acc_;           // the output row being accumulated
+    float acc_weight_ {0.0f};
+
+    double y_scale_ {1.0};
+    int src_y_ {0};
+    int dst_y_ {0};
+
+    bool simd_ {false};
+
+    void emit_row();
+};
+
+#endif // RESAMPLE_HPP
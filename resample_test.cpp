@@ -0,0 +1,68 @@
+// Checks Area_resampler's SIMD path against its scalar one, bit for bit, over random images and sizes
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "resample.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    std::vector<unsigned char> resample(const std::vector<unsigned char> & src, int src_width, int src_height,
+            int dst_width, int dst_height, Resample_path path)
+    {
+        auto dst = std::vector<unsigned char>(static_cast<std::size_t>(dst_width) * dst_height * 4);
+        auto resampler = Area_resampler{src_width, src_height, dst_width, dst_height, std::data(dst), path};
+        for(auto y = 0; y < src_height; ++y)
+            resampler.add_row(std::data(src) + static_cast<std::size_t>(y) * src_width * 4);
+        return dst;
+    }
+
+    std::string size_str(int w, int h) { return std::to_string(w) + 'x' + std::to_string(h); }
+}
+
+int main()
+{
+    // the reference itself: 2x1 to 1x1 averages in premultiplied alpha, so a transparent pixel doesn't darken the other
+    {
+        const auto src = std::vector<unsigned char>{200, 100, 50, 255, 0, 0, 0, 0};
+        const auto expected = std::vector<unsigned char>{200, 100, 50, 128};
+        check(resample(src, 2, 1, 1, 1, Resample_path::SCALAR) == expected, "scalar reference");
+    }
+
+    if(!resample_path_supported(Resample_path::SIMD))
+    {
+        std::cout<<"SIMD: not supported, skipped\n";
+        return test_result();
+    }
+
+    auto rng = std::mt19937{12345};
+    auto byte = std::uniform_int_distribution<int>{0, 255};
+
+    // odd and tiny widths, 1:1 up to large reductions. Alpha is often 0 or 255, the edge cases for unpremultiplying
+    for(auto i = 0; i < 300; ++i)
+    {
+        const auto src_width = std::uniform_int_distribution<int>{1, 301}(rng) | (i % 2);
+        const auto src_height = std::uniform_int_distribution<int>{1, 200}(rng);
+        const auto dst_width = std::uniform_int_distribution<int>{1, src_width}(rng);
+        const auto dst_height = std::uniform_int_distribution<int>{1, src_height}(rng);
+
+        auto src = std::vector<unsigned char>(static_cast<std::size_t>(src_width) * src_height * 4);
+        for(auto p = std::size_t{0}; p < std::size(src); p += 4)
+        {
+            std::generate(&src[p], &src[p] + 3, [&]{ return static_cast<unsigned char>(byte(rng)); });
+            const auto a = byte(rng);
+            src[p + 3] = static_cast<unsigned char>(a < 32 ? 0 : a > 224 ? 255 : a);
+        }
+
+        check(resample(src, src_width, src_height, dst_width, dst_height, Resample_path::SIMD)
+                == resample(src, src_width, src_height, dst_width, dst_height, Resample_path::SCALAR),
+                "SIMD matches scalar, " + size_str(src_width, src_height) + " to " + size_str(dst_width, dst_height));
+    }
+    std::cout<<"SIMD: tested\n";
+
+    return test_result();
+}
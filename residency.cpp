@@ -0,0 +1,97 @@
+#include "residency.hpp"
+
+#include <algorithm>
+
+Residency::Residency(std::size_t num_rows, int window, std::size_t pool_size):
+    num_rows_{num_rows},
+    window_{std::max(0, window)},
+    prefetch_{std::max(1, window_ / 2)},
+    pool_size_{pool_size},
+    resident_(num_rows, false)
+{}
+
+Residency::Update Residency::update(int index, int direction)
+{
+    auto update = Update{};
+    if(num_rows_ == 0)
+        return update;
+
+    const auto n = static_cast<int>(num_rows_);
+    const auto dir = direction < 0 ? -1 : 1;
+
+    // rows ahead of / behind the selection. Clamped so that no row is visited twice on short lists
+    auto ahead = std::min(window_ + (direction != 0 ? prefetch_ : 0), n - 1);
+    auto behind = std::min(window_, n - 1 - ahead);
+
+    auto wanted = std::vector<std::size_t>{};
+    wanted.reserve(ahead + behind + 1);
+
+    auto row_at = [n, index](int offset) { return static_cast<std::size_t>(((index + offset) % n + n) % n); };
+
+    wanted.push_back(row_at(0));
+    for(auto i = 1; i <= std::max(ahead, behind); ++i)
+    {
+        if(i <= ahead)
+            wanted.push_back(row_at(i * dir));
+        if(i <= behind)
+            wanted.push_back(row_at(-i * dir));
+    }
+
+    for(auto row: wanted)
+    {
+        if(auto p = pool_index_.find(row); p != std::end(pool_index_))
+        {
+            pool_.erase(p->second);
+            pool_index_.erase(p);
+        }
+        else if(!resident_[row])
+        {
+            resident_[row] = true;
+            update.load.push_back(row);
+        }
+    }
+
+    // rows that left the window go to the front of the pool
+    for(auto row: window_rows_)
+    {
+        if(std::find(std::begin(wanted), std::end(wanted), row) == std::end(wanted))
+        {
+            pool_.push_front(row);
+            pool_index_[row] = std::begin(pool_);
+        }
+    }
+
+    while(std::size(pool_) > pool_size_)
+    {
+        auto row = pool_.back();
+        pool_.pop_back();
+        pool_index_.erase(row);
+        resident_[row] = false;
+        update.unload.push_back(row);
+    }
+
+    window_rows_ = std::move(wanted);
+
+    return update;
+}
+
+void Residency::reset(std::size_t num_rows)
+{
+    num_rows_ = num_rows;
+    resident_.assign(num_rows, false);
+    window_rows_.clear();
+    pool_.clear();
+    pool_index_.clear();
+}
+
+std::vector<std::size_t> Residency::clear_pool()
+{
+    auto evicted = std::vector<std::size_t>{std::begin(pool_), std::end(pool_)};
+    for(auto row: evicted)
+        resident_[row] = false;
+
+    pool_.clear();
+    pool_index_.clear();
+
+    return evicted;
+}
@@ -0,0 +1,49 @@
+#ifndef RESIDENCY_HPP
+#define RESIDENCY_HPP
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Decides which rows of a (possibly very long) circular list should have their textures loaded:
+// every row within `window` of the selection, a few more in the direction of scrolling, and an LRU pool of the
+// `pool_size` rows that most recently left the window
+class Residency
+{
+public:
+    struct Update
+    {
+        std::vector<std::size_t> load;   // nearest the selection first
+        std::vector<std::size_t> unload;
+    };
+
+    Residency(std::size_t num_rows, int window, std::size_t pool_size);
+
+    // call whenever the selection moves. direction is the last scroll direction (-1, 0, 1)
+    Update update(int index, int direction);
+
+    // start over with a list of num_rows rows. Nothing is resident until the next update
+    void reset(std::size_t num_rows);
+
+    // evict everything in the LRU pool, returning the evicted rows. Rows in the window stay resident
+    std::vector<std::size_t> clear_pool();
+
+    // rows currently in the window, nearest the selection first
+    const std::vector<std::size_t> & get_window() const { return window_rows_; }
+    bool is_resident(std::size_t row) const { return resident_[row]; }
+
+private:
+    std::size_t num_rows_ {0};
+    int window_ {0};
+    int prefetch_ {0};
+    std::size_t pool_size_ {0};
+
+    std::vector<bool> resident_;
+    std::vector<std::size_t> window_rows_;
+
+    std::list<std::size_t> pool_; // most recently used first
+    std::unordered_map<std::size_t, std::list<std::size_t>::iterator> pool_index_;
+};
+
+#endif // RESIDENCY_HPP
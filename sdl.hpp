@@ -23,6 +23,22 @@ namespace SDL
         ~SDL() { SDL_Quit(); }
     };
 
+    struct Subsystem
+    {
+        Uint32 flags {0};
+        explicit Subsystem(Uint32 flags): flags{flags}
+        {
+            if(SDL_InitSubSystem(flags) < 0)
+                sdl_error("Unable to initialize SDL subsystem");
+        }
+        ~Subsystem() { SDL_QuitSubSystem(flags); }
+
+        Subsystem(const Subsystem &) = delete;
+        Subsystem(Subsystem &&) = delete;
+        Subsystem &operator=(const Subsystem &) = delete;
+        Subsystem &operator=(Subsystem &&) = delete;
+    };
+
     struct Window
     {
         SDL_Window * window {nullptr};
@@ -51,12 +67,22 @@ namespace SDL
     struct Renderer
     {
         SDL_Renderer * renderer {nullptr};
-        explicit Renderer(Window & window):
-            renderer{SDL_CreateRenderer(window, -1, 0)}
+        // If vsync is requested but not possible, falls back to a renderer without it
+        explicit Renderer(Window & window, Uint32 flags = 0):
+            renderer{SDL_CreateRenderer(window, -1, flags)}
         {
+            if(!renderer && (flags & SDL_RENDERER_PRESENTVSYNC))
+                renderer = SDL_CreateRenderer(window, -1, flags & ~SDL_RENDERER_PRESENTVSYNC);
             if(!renderer)
                 sdl_error("Unable to create SDL renderer");
         }
+        // software renderer drawing into surface
+        explicit Renderer(SDL_Surface * surface):
+            renderer{SDL_CreateSoftwareRenderer(surface)}
+        {
+            if(!renderer)
+                sdl_error("Unable to create SDL software renderer");
+        }
         ~Renderer() { SDL_DestroyRenderer(renderer); }
 
         Renderer(const Renderer &) = delete;
@@ -0,0 +1,269 @@
+#include "swizzle.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include <SDL2/SDL.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SWIZZLE_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SWIZZLE_NEON
+#include <arm_neon.h>
+#endif
+
+// All paths unpremultiply with (c * 255 + a / 2) / a, clamped to 255, with 0 for fully transparent pixels.
+// The SIMD paths do this division in single precision floats and truncate. For c, a <= 255, the float quotient is
+// never off by more than 2^-8, and a quotient that isn't a whole number is always at least 1/255 away from one,
+// so truncating gives exactly the same result as integer division
+
+namespace
+{
+    inline void unpremultiply_pixel(unsigned char * p)
+    {
+        auto a = p[3];
+        if(a == 255)
+            return;
+
+        for(auto c = 0; c < 3; ++c)
+            p[c] = a == 0 ? 0 : static_cast<unsigned char>(std::min(255, (p[c] * 255 + a / 2) / a));
+    }
+
+#ifdef SWIZZLE_X86
+    // unpremultiply one RGBA pixel widened to 4 x int32
+    __attribute__((target("sse2"))) inline __m128i unpremultiply_sse2(__m128i p)
+    {
+        const auto alpha_lane = _mm_setr_epi32(0, 0, 0, -1);
+
+        auto a = _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3));
+        auto num = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(p), _mm_set1_ps(255.0f)), _mm_cvtepi32_ps(_mm_srli_epi32(a, 1)));
+        auto q = _mm_cvttps_epi32(_mm_div_ps(num, _mm_cvtepi32_ps(a)));
+
+        // a == 0 divides by zero. Those lanes are cleared, and alpha passes through unchanged
+        q = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), alpha_lane), q);
+        return _mm_or_si128(q, _mm_and_si128(p, alpha_lane));
+    }
+
+    __attribute__((target("sse2"))) void bgra_to_rgba_sse2(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply)
+    {
+        const auto ga_mask = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+        const auto br_mask = _mm_set1_epi32(0x00FF00FF);
+        const auto a_mask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+        auto i = std::size_t{0};
+        for(; i + 4 <= num_pixels; i += 4)
+        {
+            auto * p = reinterpret_cast<__m128i *>(pixels + i * 4);
+            auto v = _mm_loadu_si128(p);
+
+            // no byte shuffle in SSE2: swap B and R by shifting them past each other within each 32-bit pixel
+            auto br = _mm_and_si128(v, br_mask);
+            v = _mm_or_si128(_mm_and_si128(v, ga_mask), _mm_or_si128(_mm_slli_epi32(br, 16), _mm_srli_epi32(br, 16)));
+
+            // skip the math when all 4 are opaque, which is most of a typical icon
+            if(unpremultiply && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, a_mask), a_mask)) != 0xFFFF)
+            {
+                auto zero = _mm_setzero_si128();
+                auto lo = _mm_unpacklo_epi8(v, zero);
+                auto hi = _mm_unpackhi_epi8(v, zero);
+
+                auto p0 = unpremultiply_sse2(_mm_unpacklo_epi16(lo, zero));
+                auto p1 = unpremultiply_sse2(_mm_unpackhi_epi16(lo, zero));
+                auto p2 = unpremultiply_sse2(_mm_unpacklo_epi16(hi, zero));
+                auto p3 = unpremultiply_sse2(_mm_unpackhi_epi16(hi, zero));
+
+                // saturating packs do the clamp to 255
+                v = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+            }
+
+            _mm_storeu_si128(p, v);
+        }
+
+        bgra_to_rgba_scalar(pixels + i * 4, num_pixels - i, unpremultiply);
+    }
+
+    // unpremultiply two RGBA pixels widened to 8 x int32
+    __attribute__((target("avx2"))) inline __m256i unpremultiply_avx2(__m256i p)
+    {
+        const auto alpha_lane = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+
+        auto a = _mm256_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3));
+        auto num = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(p), _mm256_set1_ps(255.0f)), _mm256_cvtepi32_ps(_mm256_srli_epi32(a, 1)));
+        auto q = _mm256_cvttps_epi32(_mm256_div_ps(num, _mm256_cvtepi32_ps(a)));
+
+        q = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()), alpha_lane), q);
+        return _mm256_or_si256(q, _mm256_and_si256(p, alpha_lane));
+    }
+
+    __attribute__((target("avx2"))) void bgra_to_rgba_avx2(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply)
+    {
+        const auto swap_br = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                              2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const auto a_mask = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+        auto i = std::size_t{0};
+        for(; i + 8 <= num_pixels; i += 8)
+        {
+            auto * p = reinterpret_cast<__m256i *>(pixels + i * 4);
+            auto v = _mm256_shuffle_epi8(_mm256_loadu_si256(p), swap_br);
+
+            if(unpremultiply && _mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(v, a_mask), a_mask)) != -1)
+            {
+                auto lo = _mm256_castsi256_si128(v);
+                auto hi = _mm256_extracti128_si256(v, 1);
+
+                auto p01 = unpremultiply_avx2(_mm256_cvtepu8_epi32(lo));
+                auto p23 = unpremultiply_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+                auto p45 = unpremultiply_avx2(_mm256_cvtepu8_epi32(hi));
+                auto p67 = unpremultiply_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+
+                // the packs work within 128-bit halves, which leaves the pixels in the order 0 2 4 6 1 3 5 7
+                auto packed = _mm256_packus_epi16(_mm256_packs_epi32(p01, p23), _mm256_packs_epi32(p45, p67));
+                v = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+            }
+
+            _mm256_storeu_si256(p, v);
+        }
+
+        bgra_to_rgba_sse2(pixels + i * 4, num_pixels - i, unpremultiply);
+    }
+#endif
+
+#ifdef SWIZZLE_NEON
+    inline std::uint8_t min_lane(uint8x16_t v)
+    {
+    #ifdef __aarch64__
+        return vminvq_u8(v);
+    #else
+        auto m = vpmin_u8(vget_low_u8(v), vget_high_u8(v));
+        m = vpmin_u8(m, m);
+        m = vpmin_u8(m, m);
+        m = vpmin_u8(m, m);
+        return vget_lane_u8(m, 0);
+    #endif
+    }
+
+#ifdef __aarch64__
+    // unpremultiply one channel of 4 pixels, given their alpha
+    inline uint32x4_t unpremultiply_neon(uint32x4_t c, uint32x4_t a)
+    {
+        auto num = vaddq_f32(vmulq_n_f32(vcvtq_f32_u32(c), 255.0f), vcvtq_f32_u32(vshrq_n_u32(a, 1)));
+        auto q = vcvtq_u32_f32(vdivq_f32(num, vcvtq_f32_u32(a)));
+        return vbicq_u32(q, vceqq_u32(a, vdupq_n_u32(0)));
+    }
+
+    inline uint8x16_t unpremultiply_neon(uint8x16_t c, uint8x16_t a)
+    {
+        auto c_lo = vmovl_u8(vget_low_u8(c)), c_hi = vmovl_u8(vget_high_u8(c));
+        auto a_lo = vmovl_u8(vget_low_u8(a)), a_hi = vmovl_u8(vget_high_u8(a));
+
+        auto q0 = unpremultiply_neon(vmovl_u16(vget_low_u16(c_lo)), vmovl_u16(vget_low_u16(a_lo)));
+        auto q1 = unpremultiply_neon(vmovl_u16(vget_high_u16(c_lo)), vmovl_u16(vget_high_u16(a_lo)));
+        auto q2 = unpremultiply_neon(vmovl_u16(vget_low_u16(c_hi)), vmovl_u16(vget_low_u16(a_hi)));
+        auto q3 = unpremultiply_neon(vmovl_u16(vget_high_u16(c_hi)), vmovl_u16(vget_high_u16(a_hi)));
+
+        // saturating narrows do the clamp to 255
+        return vcombine_u8(vqmovn_u16(vcombine_u16(vqmovn_u32(q0), vqmovn_u32(q1))),
+                           vqmovn_u16(vcombine_u16(vqmovn_u32(q2), vqmovn_u32(q3))));
+    }
+#endif
+
+    void bgra_to_rgba_neon(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply)
+    {
+        auto i = std::size_t{0};
+        for(; i + 16 <= num_pixels; i += 16)
+        {
+            auto * p = pixels + i * 4;
+
+            // de-interleaving load splits the channels into their own registers, so swapping B and R is free
+            auto bgra = vld4q_u8(p);
+            auto rgba = uint8x16x4_t{{bgra.val[2], bgra.val[1], bgra.val[0], bgra.val[3]}};
+
+            if(unpremultiply && min_lane(rgba.val[3]) != 255)
+            {
+    #ifdef __aarch64__
+                for(auto c = 0; c < 3; ++c)
+                    rgba.val[c] = unpremultiply_neon(rgba.val[c], rgba.val[3]);
+    #else
+                // 32-bit ARM has no vector divide
+                vst4q_u8(p, rgba);
+                for(auto j = 0; j < 16; ++j)
+                    unpremultiply_pixel(p + j * 4);
+                continue;
+    #endif
+            }
+
+            vst4q_u8(p, rgba);
+        }
+
+        bgra_to_rgba_scalar(pixels + i * 4, num_pixels - i, unpremultiply);
+    }
+#endif
+
+    using Swizzle_fun = void (*)(unsigned char *, std::size_t, bool);
+
+    // nullptr if not built, or not supported by the CPU
+    Swizzle_fun get_swizzle(Swizzle_path path)
+    {
+        switch(path)
+        {
+        case Swizzle_path::SCALAR:
+            return bgra_to_rgba_scalar;
+    #ifdef SWIZZLE_X86
+        case Swizzle_path::SSE2:
+            return SDL_HasSSE2() ? bgra_to_rgba_sse2 : nullptr;
+        case Swizzle_path::AVX2:
+            return SDL_HasAVX2() ? bgra_to_rgba_avx2 : nullptr;
+    #endif
+    #ifdef SWIZZLE_NEON
+        case Swizzle_path::NEON:
+            return SDL_HasNEON() ? bgra_to_rgba_neon : nullptr;
+    #endif
+        default:
+            return nullptr;
+        }
+    }
+
+    Swizzle_fun pick_swizzle()
+    {
+        for(auto path: {Swizzle_path::AVX2, Swizzle_path::SSE2, Swizzle_path::NEON})
+        {
+            if(auto swizzle = get_swizzle(path))
+                return swizzle;
+        }
+        return bgra_to_rgba_scalar;
+    }
+}
+
+void bgra_to_rgba_scalar(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply)
+{
+    for(auto * p = pixels; p != pixels + num_pixels * 4; p += 4)
+    {
+        std::swap(p[0], p[2]);
+        if(unpremultiply)
+            unpremultiply_pixel(p);
+    }
+}
+
+void bgra_to_rgba(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply)
+{
+    static const auto swizzle = pick_swizzle();
+    swizzle(pixels, num_pixels, unpremultiply);
+}
+
+bool swizzle_path_supported(Swizzle_path path)
+{
+    return get_swizzle(path) != nullptr;
+}
+
+void bgra_to_rgba(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply, Swizzle_path path)
+{
+    auto swizzle = get_swizzle(path);
+    if(!swizzle)
+        throw std::runtime_error{"Swizzle path not supported"};
+    swizzle(pixels, num_pixels, unpremultiply);
+}
@@ -0,0 +1,19 @@
+#ifndef SWIZZLE_HPP
+#define SWIZZLE_HPP
+
+#include <cstddef>
+
+// Convert cairo's ARGB32 (BGRA byte order on little-endian) to RGBA32 in place. If unpremultiply is set, color channels
+// are also divided by alpha, rounding to nearest, for use with straight-alpha blending.
+// Uses the widest SIMD path the CPU supports
+void bgra_to_rgba(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply);
+
+// plain C++ version of the above, which all of the SIMD paths match bit for bit
+void bgra_to_rgba_scalar(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply);
+
+// For testing each path against the scalar one. A path can only be used if it's both built and supported by the CPU
+enum class Swizzle_path { SCALAR, SSE2, AVX2, NEON };
+bool swizzle_path_supported(Swizzle_path path);
+void bgra_to_rgba(unsigned char * pixels, std::size_t num_pixels, bool unpremultiply, Swizzle_path path);
+
+#endif // SWIZZLE_HPP
@@ -0,0 +1,103 @@
+// Checks every SIMD path of bgra_to_rgba, that this CPU supports, against bgra_to_rgba_scalar, bit for bit
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "swizzle.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    // every (color, alpha) pair, including color > alpha, which isn't valid premultiplied but must still be clamped
+    // the same way. Each channel gets a different color, so a mixed up channel shows
+    std::vector<unsigned char> all_pairs()
+    {
+        auto pixels = std::vector<unsigned char>{};
+        for(auto a = 0; a < 256; ++a)
+        {
+            for(auto c = 0; c < 256; ++c)
+            {
+                pixels.push_back(static_cast<unsigned char>(c));
+                pixels.push_back(static_cast<unsigned char>(255 - c));
+                pixels.push_back(static_cast<unsigned char>(c / 2));
+                pixels.push_back(static_cast<unsigned char>(a));
+            }
+        }
+        return pixels;
+    }
+
+    void test_path(Swizzle_path path, const char * name)
+    {
+        const auto input = all_pairs();
+
+        for(auto unpremultiply: {false, true})
+        {
+            const auto what = std::string{name} + (unpremultiply ? ", unpremultiplied" : "");
+
+            auto expected = input;
+            bgra_to_rgba_scalar(std::data(expected), std::size(expected) / 4, unpremultiply);
+            auto actual = input;
+            bgra_to_rgba(std::data(actual), std::size(actual) / 4, unpremultiply, path);
+
+            for(auto i = std::size_t{0}; i < std::size(input); i += 4)
+            {
+                if(!std::equal(&expected[i], &expected[i] + 4, &actual[i]))
+                {
+                    check(false, what + ": pixel BGRA " + std::to_string(input[i]) + ' ' + std::to_string(input[i + 1]) + ' '
+                            + std::to_string(input[i + 2]) + ' ' + std::to_string(input[i + 3]));
+                    break;
+                }
+            }
+
+            // lengths and starting points that leave partial vectors at either end, which must convert only what
+            // they're given
+            for(auto offset = std::size_t{0}; offset < 9; ++offset)
+            {
+                for(auto length = std::size_t{0}; length < 40; ++length)
+                {
+                    auto expected = std::vector<unsigned char>(std::begin(input) + 1000 * 4, std::begin(input) + 1100 * 4);
+                    auto actual = expected;
+                    bgra_to_rgba_scalar(std::data(expected) + offset * 4, length, unpremultiply);
+                    bgra_to_rgba(std::data(actual) + offset * 4, length, unpremultiply, path);
+
+                    check(expected == actual, what + ": offset " + std::to_string(offset) + ", length " + std::to_string(length));
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    // the reference itself: swap B and R, and divide color by alpha, rounding to nearest
+    {
+        unsigned char p[] = {64, 32, 16, 128, 10, 20, 30, 0, 1, 2, 3, 255};
+        bgra_to_rgba_scalar(p, 3, true);
+        const unsigned char expected[] = {32, 64, 128, 128, 0, 0, 0, 0, 3, 2, 1, 255};
+        check(std::equal(std::begin(p), std::end(p), std::begin(expected)), "scalar reference");
+    }
+
+    const std::pair<Swizzle_path, const char *> paths[] =
+    {
+        {Swizzle_path::SCALAR, "scalar"},
+        {Swizzle_path::SSE2, "SSE2"},
+        {Swizzle_path::AVX2, "AVX2"},
+        {Swizzle_path::NEON, "NEON"},
+    };
+
+    for(auto & [path, name]: paths)
+    {
+        if(!swizzle_path_supported(path))
+        {
+            std::cout<<name<<": not supported, skipped\n";
+            continue;
+        }
+        test_path(path, name);
+        std::cout<<name<<": tested\n";
+    }
+
+    return test_result();
+}
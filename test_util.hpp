@@ -0,0 +1,60 @@
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+// Shared by the unit tests. Each check() that fails is reported and counted, and main returns test_result()
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+inline int test_failures = 0;
+
+inline void check(bool ok, const std::string & what)
+{
+    if(!ok)
+    {
+        std::cerr<<"FAIL: "<<what<<'\n';
+        ++test_failures;
+    }
+}
+
+// the process exit status
+inline int test_result()
+{
+    if(test_failures)
+        std::cerr<<test_failures<<" failures\n";
+    return test_failures ? 1 : 0;
+}
+
+// a new, empty directory under the system temp dir, removed with everything in it on destruction
+class Temp_dir
+{
+public:
+    explicit Temp_dir(const std::string & prefix)
+    {
+        auto path = (std::filesystem::temp_directory_path() / (prefix + ".XXXXXX")).string();
+        if(!mkdtemp(std::data(path)))
+            throw std::runtime_error{"Could not create temp dir " + path + " - " + std::strerror(errno)};
+        path_ = path;
+    }
+    ~Temp_dir()
+    {
+        auto ec = std::error_code{};
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    Temp_dir(const Temp_dir &) = delete;
+    Temp_dir &operator=(const Temp_dir &) = delete;
+
+    const std::filesystem::path & path() const { return path_; }
+
+private:
+    std::filesystem::path path_;
+};
+
+#endif // TEST_UTIL_HPP
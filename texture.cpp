@@ -1,13 +1,19 @@
 #include "texture.hpp"
+#include "image_cache.hpp"
+#include "file.hpp"
+#include "resample.hpp"
 #include "sdl.hpp"
+#include "swizzle.hpp"
 
+#include <algorithm>
 #include <array>
-#include <fstream>
+#include <cmath>
 #include <stdexcept>
-#include <tuple>
 #include <variant>
 #include <vector>
 
+#include <csetjmp>
+#include <cstdio>
 #include <cstring>
 #include <cerrno>
 
@@ -35,33 +41,131 @@ namespace
         std::vector<std::pair<void *, void (*)(void*)>> objs;
     };
 
-    std::vector<char> read_to_vector(const std::string & path)
+    struct not_svg_error: public std::runtime_error
     {
-        std::vector<char> data;
-        std::array<char, 4096> buffer;
+        not_svg_error(const std::string & what): std::runtime_error(what) {}
+    };
 
-        auto input = std::ifstream{path, std::ios::binary};
-        if(!input)
-            throw std::runtime_error {"Error opening input file: " + path + " - " + strerror(errno)};
-        while(input)
-        {
-            input.read(std::data(buffer), std::size(buffer));
-            if(input.bad())
-                throw std::runtime_error {"Error reading input file: " + path + " - " + strerror(errno)};
+    struct Png_source
+    {
+        std::span<const char> data;
+        std::size_t pos {0};
+        char error[256] {};
+    };
+
+    void png_read_from_source(png_structp png, png_bytep out, png_size_t size)
+    {
+        auto * source = static_cast<Png_source *>(png_get_io_ptr(png));
+        if(size > std::size(source->data) - source->pos)
+            png_error(png, "truncated");
 
-            data.insert(std::end(data), std::begin(buffer), std::begin(buffer) + input.gcount());
+        std::memcpy(out, std::data(source->data) + source->pos, size);
+        source->pos += size;
+    }
+
+    [[noreturn]] void png_error_to_source(png_structp png, png_const_charp message)
+    {
+        auto * source = static_cast<Png_source *>(png_get_error_ptr(png));
+        std::snprintf(source->error, sizeof(source->error), "%s", message);
+        png_longjmp(png, 1);
+    }
+
+    void png_ignore_warning(png_structp, png_const_charp) {}
+
+    // Decode rows straight into resampler. Interlaced images need every pass to finish any row, so they're decoded
+    // whole, into image, first.
+    // libpng errors longjmp back to here, so nothing with a destructor may be created in this function. Returns false on
+    // error, with the message in the error_ptr's Png_source
+    bool read_png_rows(png_structp png, png_infop info, Area_resampler & resampler,
+            std::vector<unsigned char> & row, std::vector<unsigned char> & image, std::vector<png_bytep> & image_rows)
+    {
+        if(setjmp(png_jmpbuf(png)))
+            return false;
+
+        png_read_info(png, info);
+
+        // the same straight alpha, 8 bit sRGB RGBA as the simplified API's PNG_FORMAT_RGBA
+        png_set_alpha_mode(png, PNG_ALPHA_PNG, PNG_DEFAULT_sRGB);
+        png_set_expand(png);
+        png_set_scale_16(png);
+        png_set_gray_to_rgb(png);
+        if(!(png_get_color_type(png, info) & PNG_COLOR_MASK_ALPHA) && !png_get_valid(png, info, PNG_INFO_tRNS))
+            png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+        const auto passes = png_set_interlace_handling(png);
+        png_read_update_info(png, info);
+
+        const auto width = png_get_image_width(png, info);
+        const auto height = png_get_image_height(png, info);
+        if(png_get_rowbytes(png, info) != std::size(row))
+            png_error(png, "unexpected row size");
+
+        if(passes == 1)
+        {
+            for(auto y = 0u; y < height; ++y)
+            {
+                png_read_row(png, std::data(row), nullptr);
+                resampler.add_row(std::data(row));
+            }
+        }
+        else
+        {
+            image.resize(static_cast<std::size_t>(width) * height * 4);
+            image_rows.resize(height);
+            for(auto y = 0u; y < height; ++y)
+                image_rows[y] = std::data(image) + static_cast<std::size_t>(y) * width * 4;
+
+            png_read_image(png, std::data(image_rows));
+            for(auto y = 0u; y < height; ++y)
+                resampler.add_row(image_rows[y]);
         }
 
-        return data;
+        return true;
     }
 
-    struct not_svg_error: public std::runtime_error
+    // PNG decoded and shrunk to content_width x content_height while it's read, so the full size image isn't held
+    SDL::Decoded_image read_png_scaled(const std::span<const char> & png_mem, int png_width, int png_height,
+            int content_width, int content_height, int viewport_width, int viewport_height)
     {
-        not_svg_error(const std::string & what): std::runtime_error(what) {}
-    };
+        auto source = Png_source{png_mem};
+
+        struct Read_struct
+        {
+            png_structp png {nullptr};
+            png_infop info {nullptr};
+            ~Read_struct() { png_destroy_read_struct(&png, info ? &info : nullptr, nullptr); }
+        } read;
+
+        read.png = png_create_read_struct(PNG_LIBPNG_VER_STRING, &source, png_error_to_source, png_ignore_warning);
+        if(!read.png)
+            throw std::runtime_error{"Unable to open PNG: out of memory"};
+        read.info = png_create_info_struct(read.png);
+        if(!read.info)
+            throw std::runtime_error{"Unable to open PNG: out of memory"};
+        png_set_read_fn(read.png, &source, png_read_from_source);
+
+        auto decoded = SDL::Decoded_image
+        {
+            .image = SDL::Image{std::vector<unsigned char>(static_cast<std::size_t>(content_width) * content_height * 4), content_width, content_height},
+            .rescalable = true, // a larger viewport can get more detail out of the file
+            .width = viewport_width,
+            .height = viewport_height,
+            .content = SDL_Rect{(viewport_width - content_width) / 2, (viewport_height - content_height) / 2, content_width, content_height}
+        };
+
+        auto resampler = Area_resampler{png_width, png_height, content_width, content_height, std::data(decoded.image.pixels)};
+        auto row = std::vector<unsigned char>(static_cast<std::size_t>(png_width) * 4);
+        auto image = std::vector<unsigned char>{};
+        auto image_rows = std::vector<png_bytep>{};
+
+        if(!read_png_rows(read.png, read.info, resampler, row, image, image_rows))
+            throw std::runtime_error{"Unable to read PNG: " + std::string{source.error}};
+
+        return decoded;
+    }
 
-    std::tuple<std::vector<unsigned char>, int, int> read_png(const std::span<char> & png_mem,
-            int viewport_width, int viewport_height)
+    // PNGs larger than the viewport are shrunk to fit it as they're decoded (see read_png_scaled). Smaller ones are
+    // decoded at their own size, and the letterboxed size matches the viewport's aspect ratio, without scaling
+    SDL::Decoded_image read_png(const std::span<const char> & png_mem, int viewport_width, int viewport_height)
     {
         RAII_stack rs;
         png_image png;
@@ -77,11 +181,15 @@ namespace
 
         png.format = PNG_FORMAT_RGBA;
 
-        std::vector<unsigned char> raw_pixel_data(PNG_IMAGE_SIZE(png));
-
-        if(!png_image_finish_read(&png, nullptr, std::data(raw_pixel_data), PNG_IMAGE_ROW_STRIDE(png), nullptr))
+        if(viewport_width > 0 && viewport_height > 0
+                && (static_cast<int>(png.width) > viewport_width || static_cast<int>(png.height) > viewport_height))
         {
-            throw std::runtime_error{"Unable to read PNG: " + std::string{png.message}};
+            auto scale = std::min(static_cast<double>(viewport_width) / png.width, static_cast<double>(viewport_height) / png.height);
+            auto content_width = std::clamp(static_cast<int>(std::lround(png.width * scale)), 1, viewport_width);
+            auto content_height = std::clamp(static_cast<int>(std::lround(png.height * scale)), 1, viewport_height);
+
+            return read_png_scaled(png_mem, static_cast<int>(png.width), static_cast<int>(png.height),
+                    content_width, content_height, viewport_width, viewport_height);
         }
 
         int x_offset = 0, y_offset = 0;
@@ -110,16 +218,26 @@ namespace
             viewport_height = png.height;
         }
 
-        std::vector<unsigned char> letterboxed_pixel_data(viewport_width * viewport_height * 4, 0);
-
-        for(auto row = 0u; row < png.height; ++row)
-            std::memcpy(std::data(letterboxed_pixel_data) + ((y_offset + row) * viewport_width + x_offset) * 4, std::data(raw_pixel_data) + row * png.width * 4,  png.width * 4);
+        auto decoded = SDL::Decoded_image
+        {
+            .image = SDL::Image{std::vector<unsigned char>(PNG_IMAGE_SIZE(png)), static_cast<int>(png.width), static_cast<int>(png.height)},
+            .rescalable = false,
+            .width = viewport_width,
+            .height = viewport_height,
+            .content = SDL_Rect{x_offset, y_offset, static_cast<int>(png.width), static_cast<int>(png.height)}
+        };
+
+        if(!png_image_finish_read(&png, nullptr, std::data(decoded.image.pixels), PNG_IMAGE_ROW_STRIDE(png), nullptr))
+        {
+            throw std::runtime_error{"Unable to read PNG: " + std::string{png.message}};
+        }
 
-        return {letterboxed_pixel_data, viewport_width, viewport_height};
+        return decoded;
     }
 
-    std::tuple<std::vector<unsigned char>, int, int> read_svg(const std::span<char> & svg_data,
-            int viewport_width, int viewport_height)
+    // SVGs are rendered at the largest size that fits in the viewport. Cairo renders directly into the returned buffer,
+    // which is then converted to straight-alpha RGBA in place
+    SDL::Decoded_image read_svg(const std::span<const char> & svg_data, int viewport_width, int viewport_height)
     {
         RAII_stack rs;
 
@@ -160,8 +278,6 @@ namespace
         height = dims.height;
     #endif
 
-        double x_offset = 0, y_offset = 0;
-
         if(viewport_width > 0 && viewport_height > 0)
         {
             auto img_ratio = width / height;
@@ -171,20 +287,35 @@ namespace
             {
                 width = viewport_height * img_ratio;
                 height = viewport_height;
-                x_offset = (viewport_width - width) / 2.0;
             }
             else
             {
                 width = viewport_width;
                 height = viewport_width / img_ratio;
-                y_offset = (viewport_height - height) / 2.0;
             }
         }
+        else
+        {
+            viewport_width = static_cast<int>(width);
+            viewport_height = static_cast<int>(height);
+        }
 
-        int pixel_width = static_cast<int>(width + 2.0 * x_offset);
-        int pixel_height = static_cast<int>(height + 2.0 * y_offset);
+        int pixel_width = std::max(1, static_cast<int>(width));
+        int pixel_height = std::max(1, static_cast<int>(height));
 
-        cairo_surface_t * surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, pixel_width, pixel_height);
+        auto decoded = SDL::Decoded_image
+        {
+            .image = SDL::Image{std::vector<unsigned char>(static_cast<std::size_t>(pixel_width) * pixel_height * 4, 0), pixel_width, pixel_height},
+            .rescalable = true,
+            .width = viewport_width,
+            .height = viewport_height,
+            .content = SDL_Rect{(viewport_width - pixel_width) / 2, (viewport_height - pixel_height) / 2, pixel_width, pixel_height}
+        };
+
+        if(cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, pixel_width) != pixel_width * 4)
+            throw std::runtime_error {"Invalid SVG stride"};
+
+        cairo_surface_t * surface = cairo_image_surface_create_for_data(std::data(decoded.image.pixels), CAIRO_FORMAT_ARGB32, pixel_width, pixel_height, pixel_width * 4);
         rs.push(surface, cairo_surface_destroy);
         if(cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
             throw std::runtime_error { "Error creating SVG cairo surface" };
@@ -195,7 +326,7 @@ namespace
             throw std::runtime_error {"Error creating SVG cairo object"};
 
     #if LIBRSVG_MAJOR_VERSION > 2 || (LIBRSVG_MAJOR_VERSION == 2 && LIBRSVG_MINOR_VERSION >= 52)
-        auto viewport = RsvgRectangle {.x=x_offset, .y=y_offset, .width=width, .height=height};
+        auto viewport = RsvgRectangle {.x=0.0, .y=0.0, .width=static_cast<double>(pixel_width), .height=static_cast<double>(pixel_height)};
         if(GError * err = nullptr; !rsvg_handle_render_document(handle, cr, &viewport, &err))
         {
             rs.push(err, g_error_free);
@@ -208,45 +339,29 @@ namespace
         }
     #endif
 
-        std::vector<unsigned char> letterboxed_pixel_data((2 * y_offset + height) * (2 * x_offset + width) * 4, 0);
-
-        if(cairo_image_surface_get_stride(surface) < pixel_width * 4)
-            throw std::runtime_error {"Invalid SVG stride"};
+        cairo_surface_flush(surface);
 
-        auto * surface_data = cairo_image_surface_get_data(surface);
-        const auto surface_stride = cairo_image_surface_get_stride(surface);
-        for(int row = 0; row < pixel_height; ++row)
-        {
-            for(int col = 0; col < pixel_width; ++col)
-            {
-                // convert BGRA to RGBA
-                letterboxed_pixel_data[(row * pixel_width + col) * 4 + 0] = surface_data[(surface_stride * row) + col * 4 + 2];
-                letterboxed_pixel_data[(row * pixel_width + col) * 4 + 1] = surface_data[(surface_stride * row) + col * 4 + 1];
-                letterboxed_pixel_data[(row * pixel_width + col) * 4 + 2] = surface_data[(surface_stride * row) + col * 4 + 0];
-                letterboxed_pixel_data[(row * pixel_width + col) * 4 + 3] = surface_data[(surface_stride * row) + col * 4 + 3];
-            }
-        }
+        // cairo's output is premultiplied, but textures are blended with straight alpha
+        bgra_to_rgba(std::data(decoded.image.pixels), std::size(decoded.image.pixels) / 4, true);
 
-        return {letterboxed_pixel_data, pixel_width, pixel_height};
+        return decoded;
     }
 
-    std::tuple<std::vector<unsigned char>, int, int, bool> load_image_from_span(const std::span<char> & image_data,
-            int viewport_height, int viewport_width)
+    SDL::Decoded_image load_image_from_span(const std::span<const char> & image_data, int viewport_width, int viewport_height)
     {
         const std::array<unsigned char, 8> png_header = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
-        auto is_png = std::equal(std::begin(png_header), std::end(png_header), std::begin(image_data), [](unsigned char a, char b) { return a == static_cast<unsigned char>(b); });
+        auto is_png = std::size(image_data) >= std::size(png_header)
+            && std::equal(std::begin(png_header), std::end(png_header), std::begin(image_data), [](unsigned char a, char b) { return a == static_cast<unsigned char>(b); });
 
         if(is_png)
         {
-            auto && [data, width, height] = read_png(image_data, viewport_width, viewport_height);
-            return {data, width, height, false};
+            return read_png(image_data, viewport_width, viewport_height);
         }
         else
         {
             try
             {
-                auto && [data, width, height] = read_svg(image_data, viewport_width, viewport_height);
-                return {data, width, height, true};
+                return read_svg(image_data, viewport_width, viewport_height);
             }
             catch(const not_svg_error & e)
             {
@@ -255,6 +370,43 @@ namespace
         }
     }
 
+    // 2x2 box filter, weighted by alpha so that transparent pixels don't darken the edges
+    SDL::Image halve(const SDL::Image & src)
+    {
+        auto w = std::max(1, src.width / 2);
+        auto h = std::max(1, src.height / 2);
+        auto dst = SDL::Image{std::vector<unsigned char>(static_cast<std::size_t>(w) * h * 4), w, h};
+
+        const auto * src_data = src.data();
+        for(auto y = 0; y < h; ++y)
+        {
+            for(auto x = 0; x < w; ++x)
+            {
+                unsigned int sum[3] = {0, 0, 0};
+                unsigned int alpha_sum = 0;
+                for(auto dy = 0; dy < 2; ++dy)
+                {
+                    for(auto dx = 0; dx < 2; ++dx)
+                    {
+                        auto sx = std::min(2 * x + dx, src.width - 1);
+                        auto sy = std::min(2 * y + dy, src.height - 1);
+                        const auto * p = src_data + (static_cast<std::size_t>(sy) * src.width + sx) * 4;
+                        for(auto c = 0; c < 3; ++c)
+                            sum[c] += p[c] * p[3];
+                        alpha_sum += p[3];
+                    }
+                }
+
+                auto * d = std::data(dst.pixels) + (static_cast<std::size_t>(y) * w + x) * 4;
+                for(auto c = 0; c < 3; ++c)
+                    d[c] = static_cast<unsigned char>(alpha_sum ? (sum[c] + alpha_sum / 2) / alpha_sum : 0);
+                d[3] = static_cast<unsigned char>((alpha_sum + 2) / 4);
+            }
+        }
+
+        return dst;
+    }
+
     SDL_Texture * load_texture_from_data(SDL::Renderer & renderer, const unsigned char * raw_pixel_data, int width, int height)
     {
         auto texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height);
@@ -268,7 +420,7 @@ namespace
         }
 
         SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
-        if(width < 48 || height < 48)
+        if(SDL::use_nearest_filtering(width, height))
             SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
         else
             SDL_SetTextureScaleMode(texture, SDL_ScaleModeBest);
@@ -279,23 +431,63 @@ namespace
 
 namespace SDL
 {
+    Decoded_image decode_image(const std::string & img_path, int viewport_width, int viewport_height, Image_cache * cache)
+    {
+        if(cache)
+        {
+            if(auto cached = cache->load(img_path, viewport_width, viewport_height); cached)
+                return std::move(*cached);
+        }
+
+        // read, not mapped: thumbnails are the user's files, and one rewritten in place mid-decode would raise SIGBUS in
+        // a mapping. Read into a buffer, it's just a snapshot that fails to decode, or decodes the old image
+        const auto file = File{img_path}.read_all();
+        auto decoded = load_image_from_span(std::span{std::data(file), std::size(file)}, viewport_width, viewport_height);
+
+        if(cache)
+            cache->store(img_path, viewport_width, viewport_height, decoded);
+
+        return decoded;
+    }
+
     Texture::Texture(Renderer & renderer, const std::string & img_path,
-            int viewport_width, int viewport_height):
-        stored_image_{img_path}
+            int viewport_width, int viewport_height, Image_cache * cache):
+        Texture{renderer, decode_image(img_path, viewport_width, viewport_height, cache), img_path, cache}
+    {}
+
+    Texture::Texture(Renderer & renderer, Decoded_image && decoded, const std::string & img_path, Image_cache * cache):
+        width_{decoded.width}, height_{decoded.height},
+        content_{decoded.content},
+        stored_image_{img_path},
+        rescalable_{decoded.rescalable},
+        cache_{cache},
+        image_{std::move(decoded.image)}
     {
-        auto file_data = read_to_vector(img_path);
-        auto image_data = load_image_from_span(std::span{std::data(file_data), std::size(file_data)}, viewport_width, viewport_height);
-        std::tie(std::ignore, width_, height_, rescalable_) = image_data;
-        texture_ = load_texture_from_data(renderer, std::data(std::get<0>(image_data)), width_, height_);
+        texture_ = load_texture_from_data(renderer, image_.data(), image_.width, image_.height);
     }
 
     Texture::Texture(Renderer & renderer, const std::span<char> & img_data,
             int viewport_width, int viewport_height):
-        stored_image_{img_data}
+        Texture{renderer, load_image_from_span(img_data, viewport_width, viewport_height), std::string{}}
     {
-        auto image_data = load_image_from_span(img_data, viewport_width, viewport_height);
-        std::tie(std::ignore, width_, height_, rescalable_) = image_data;
-        texture_ = load_texture_from_data(renderer, std::data(std::get<0>(image_data)), width_, height_);
+        stored_image_ = img_data;
+    }
+
+    Texture::Texture(Renderer & renderer, Surface & surface):
+        width_{surface->w}, height_{surface->h},
+        content_{0, 0, surface->w, surface->h}
+    {
+        auto rgba_surface = Surface{SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0)};
+        if(!rgba_surface.surface)
+            sdl_error("Unable to convert SDL surface");
+
+        image_ = Image{std::vector<unsigned char>(width_ * height_ * 4), width_, height_};
+
+        auto * surface_data = static_cast<const unsigned char *>(rgba_surface->pixels);
+        for(int row = 0; row < height_; ++row)
+            std::memcpy(std::data(image_.pixels) + row * width_ * 4, surface_data + row * rgba_surface->pitch, width_ * 4);
+
+        texture_ = load_texture_from_data(renderer, std::data(image_.pixels), width_, height_);
     }
 
     void Texture::render(Renderer & renderer, int x, int y, int size_w, int size_h)
@@ -303,23 +495,163 @@ namespace SDL
         if(!texture_)
             return;
 
-        SDL_Rect render_dest;
-
-        render_dest.x = x;
-        render_dest.y = y;
-        render_dest.w = size_w ? size_w : width_;
-        render_dest.h = size_h ? size_h : height_;
+        auto render_dest = dest_rect(x, y, size_w, size_h);
         SDL_RenderCopy(renderer, texture_, nullptr, &render_dest);
     }
 
+    void Texture::render(Batch & batch, SDL_Color color, int x, int y, int size_w, int size_h)
+    {
+        auto render_dest = dest_rect(x, y, size_w, size_h);
+
+        if(atlas_ && atlas_->contains(region_))
+            batch.add(atlas_->get_page(region_.page), region_.rect, atlas_->get_page_size(), atlas_->get_page_size(), render_dest, color);
+        else if(texture_)
+            batch.add(texture_, SDL_Rect{0, 0, image_.width, image_.height}, image_.width, image_.height, render_dest, color);
+    }
+
+    SDL_Rect Texture::dest_rect(int x, int y, int size_w, int size_h) const
+    {
+        if(!size_w)
+            size_w = width_;
+        if(!size_h)
+            size_h = height_;
+
+        if(width_ == 0 || height_ == 0)
+            return SDL_Rect{x, y, size_w, size_h};
+
+        // scale the content rect the same way the whole letterboxed texture would be
+        auto x0 = x + content_.x * size_w / width_;
+        auto y0 = y + content_.y * size_h / height_;
+        auto x1 = x + (content_.x + content_.w) * size_w / width_;
+        auto y1 = y + (content_.y + content_.h) * size_h / height_;
+
+        return SDL_Rect{x0, y0, x1 - x0, y1 - y0};
+    }
+
     void Texture::rescale(Renderer & renderer, int width, int height)
     {
-        if(!texture_ || !rescalable_)
+        if((!texture_ && image_.empty()) || !rescalable_)
             return;
 
+        auto * memory = charge_.get_memory();
+        auto category = charge_.get_category();
+
         if(auto filename = std::get_if<std::string>(&stored_image_); filename)
-            *this = Texture{renderer, *filename, width, height};
+            *this = Texture{renderer, *filename, width, height, cache_};
         else
             *this = Texture{renderer, std::get<std::span<char>>(stored_image_), width, height};
+
+        if(memory)
+            account(*memory, category);
+    }
+
+    bool Texture::downscale(Renderer & renderer, int size_w, int size_h)
+    {
+        auto dest = dest_rect(0, 0, size_w, size_h);
+        dest.w = std::max(1, dest.w);
+        dest.h = std::max(1, dest.h);
+
+        if(image_.empty() || image_.width / 2 < dest.w || image_.height / 2 < dest.h)
+            return false;
+
+        while(image_.width / 2 >= dest.w && image_.height / 2 >= dest.h)
+            image_ = halve(image_);
+
+        if(auto * memory = charge_.get_memory(); memory)
+            account(*memory, charge_.get_category());
+
+        release();
+        atlas_ = nullptr;
+        restore(renderer);
+
+        return true;
+    }
+
+    void Texture::account(Texture_memory & memory, Texture_memory::Category category)
+    {
+        // release the old charge first, so it isn't counted twice towards the peak
+        charge_ = Texture_memory::Charge{};
+        charge_ = memory.charge(category, get_bytes());
+    }
+
+    void Texture::release()
+    {
+        if(texture_)
+        {
+            SDL_DestroyTexture(texture_);
+            texture_ = nullptr;
+        }
+    }
+
+    void Texture::restore(Renderer & renderer)
+    {
+        if(texture_ || image_.empty())
+            return;
+
+        texture_ = load_texture_from_data(renderer, image_.data(), image_.width, image_.height);
+    }
+
+    bool Texture::pack(Renderer & renderer, Atlas & atlas)
+    {
+        if(atlas_ == &atlas && atlas.contains(region_))
+            return true;
+
+        if(auto region = atlas.add(renderer, image_); region)
+        {
+            atlas_ = &atlas;
+            region_ = *region;
+            release();
+            return true;
+        }
+
+        atlas_ = nullptr;
+        restore(renderer);
+        return false;
+    }
+
+    Render_target::Render_target(Renderer & renderer, int width, int height):
+        texture_{SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height)},
+        width_{width}, height_{height}
+    {
+        if(!texture_)
+            sdl_error("Unable to create SDL render target");
+
+        const auto premultiplied = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+        if(SDL_SetTextureBlendMode(texture_, premultiplied) < 0)
+        {
+            SDL_DestroyTexture(texture_);
+            texture_ = nullptr;
+            sdl_error("Unable to set render target blend mode");
+        }
+        // always drawn at its natural size
+        SDL_SetTextureScaleMode(texture_, SDL_ScaleModeNearest);
+    }
+
+    void Render_target::account(Texture_memory & memory, Texture_memory::Category category)
+    {
+        charge_ = Texture_memory::Charge{};
+        charge_ = memory.charge(category, static_cast<std::size_t>(width_) * height_ * 4);
+    }
+
+    void Render_target::compose(Renderer & renderer, Batch & batch)
+    {
+        if(SDL_SetRenderTarget(renderer, texture_) < 0)
+            sdl_error("Unable to set render target");
+
+        Uint8 r, g, b, a;
+        SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        batch.draw(renderer);
+
+        SDL_SetRenderTarget(renderer, nullptr);
+        SDL_SetRenderDrawColor(renderer, r, g, b, a);
+    }
+
+    void Render_target::render(Batch & batch, SDL_Color color, int x, int y)
+    {
+        if(texture_)
+            batch.add(texture_, SDL_Rect{0, 0, width_, height_}, width_, height_, SDL_Rect{x, y, width_, height_}, color);
     }
 }
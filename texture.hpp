@@ -4,42 +4,72 @@
 #include <span>
 #include <variant>
 
+#include "atlas.hpp"
+#include "image.hpp"
 #include "sdl.hpp"
+#include "texture_memory.hpp"
+
+class Image_cache;
 
 namespace SDL
 {
+    struct Decoded_image
+    {
+        Image image;
+        bool rescalable {false};
+
+        // The letterboxed size, matching the viewport's aspect ratio, and where image sits within it.
+        // Only the content itself is decoded; the borders are applied when rendering
+        int width {0};
+        int height {0};
+        SDL_Rect content {};
+    };
+
+    // Read and decode a PNG or SVG file, letterboxed to fit the viewport. Uses and populates cache if given.
+    // Doesn't touch the renderer, so it is safe to call from any thread
+    Decoded_image decode_image(const std::string & img_path, int viewport_width = 0, int viewport_height = 0, Image_cache * cache = nullptr);
+
     class Texture
     {
     private:
         SDL_Texture * texture_ {nullptr};
+        // letterboxed size. Only content_ within it has pixels, in image_ and texture_
         int width_ {0};
         int height_ {0};
+        SDL_Rect content_ {};
 
         std::variant<std::string, std::span<char>> stored_image_;
         bool rescalable_ {false};
+        Image_cache * cache_ {nullptr};
+
+        Image image_;
+
+        Atlas * atlas_ {nullptr};
+        Atlas_region region_ {};
+
+        Texture_memory::Charge charge_;
 
     public:
         Texture() = default;
         Texture(Renderer & renderer, int width, int height):
             texture_{SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height)},
-            width_{width}, height_{height}
+            width_{width}, height_{height},
+            content_{0, 0, width, height},
+            image_{{}, width, height}
         {
             if(!texture_)
                 sdl_error("Unable to create SDL texture");
         }
         Texture(Renderer & renderer, const std::string & img_path,
-                int viewport_width = 0, int viewport_height = 0);
+                int viewport_width = 0, int viewport_height = 0, Image_cache * cache = nullptr);
+
+        // upload an image already decoded by decode_image(img_path, ...)
+        Texture(Renderer & renderer, Decoded_image && decoded, const std::string & img_path, Image_cache * cache = nullptr);
 
         Texture(Renderer & renderer, const std::span<char> & img_data,
                 int viewport_width = 0, int viewport_height = 0);
 
-        Texture(Renderer & renderer, Surface & surface):
-            texture_{SDL_CreateTextureFromSurface(renderer, surface)},
-            width_{surface->w}, height_{surface->h}
-        {
-            if(!texture_)
-                sdl_error("Unable to create SDL texture");
-        }
+        Texture(Renderer & renderer, Surface & surface);
         ~Texture()
         {
             if(texture_)
@@ -53,8 +83,14 @@ namespace SDL
             texture_{t.texture_},
             width_{std::move(t.width_)},
             height_{std::move(t.height_)},
+            content_{t.content_},
             stored_image_{std::move(t.stored_image_)},
-            rescalable_{std::move(t.rescalable_)}
+            rescalable_{std::move(t.rescalable_)},
+            cache_{t.cache_},
+            image_{std::move(t.image_)},
+            atlas_{t.atlas_},
+            region_{t.region_},
+            charge_{std::move(t.charge_)}
         {
             t.texture_ = nullptr;
         }
@@ -62,17 +98,26 @@ namespace SDL
         {
             if(&t != this)
             {
+                if(texture_)
+                    SDL_DestroyTexture(texture_);
                 texture_ = t.texture_;
                 t.texture_ = nullptr;
                 width_ = std::move(t.width_);
                 height_ = std::move(t.height_);
+                content_ = t.content_;
                 stored_image_ = std::move(t.stored_image_);
                 rescalable_ = std::move(t.rescalable_);
+                cache_ = t.cache_;
+                image_ = std::move(t.image_);
+                atlas_ = t.atlas_;
+                region_ = t.region_;
+                charge_ = std::move(t.charge_);
             }
             return *this;
         }
 
-        operator bool const() { return texture_; }
+        // true if there is anything to draw, whether it's in its own texture, an atlas, or only held in memory
+        operator bool const() { return texture_ || !image_.empty(); }
         operator const SDL_Texture*() const { return texture_; }
         operator SDL_Texture*() { return texture_; }
 
@@ -84,12 +129,100 @@ namespace SDL
             return dims;
         }
 
+        // draw at x, y scaled to size_w x size_h (or the natural size if 0). The letterboxed borders are left undrawn
         void render(Renderer & renderer, int x, int y, int size_w = 0, int size_h = 0);
+        void render(Batch & batch, SDL_Color color, int x, int y, int size_w = 0, int size_h = 0);
 
         int get_width() const { return width_; }
         int get_height() const { return height_; }
+        bool is_rescalable() const { return rescalable_; }
 
         void rescale(Renderer & renderer, int width, int height);
+
+        // Halve the resolution until it's no more than needed to draw at size_w x size_h (see render).
+        // Returns false if it was already small enough. Any atlas region is dropped, so the texture needs packing again
+        bool downscale(Renderer & renderer, int size_w, int size_h);
+
+        // count this texture's pixel data against memory until it's destroyed. Kept through rescale and downscale
+        void account(Texture_memory & memory, Texture_memory::Category category);
+        std::size_t get_bytes() const { return static_cast<std::size_t>(image_.width) * image_.height * 4; }
+
+        const Image & get_image() const { return image_; }
+        const SDL_Rect & get_content() const { return content_; }
+
+        // destroy the GPU texture, keeping the pixel data. Must be called before the renderer is destroyed
+        void release();
+        // re-upload released pixel data to a (possibly new) renderer
+        void restore(Renderer & renderer);
+
+        // move the pixel data into atlas, freeing the standalone texture. If it doesn't fit, the standalone texture is
+        // kept (or restored) instead, and false is returned
+        bool pack(Renderer & renderer, Atlas & atlas);
+
+    private:
+        // where content_ lands when the whole letterboxed texture is drawn at x, y, size_w x size_h
+        SDL_Rect dest_rect(int x, int y, int size_w, int size_h) const;
+    };
+
+    // A texture to draw into, for caching something composed from many others. Its pixels exist only on the GPU, so they
+    // are lost with the renderer, and whenever the renderer sends SDL_RENDER_TARGETS_RESET.
+    // Contents are premultiplied, so a partly transparent result blends the same as its parts would have
+    class Render_target
+    {
+    private:
+        SDL_Texture * texture_ {nullptr};
+        int width_ {0};
+        int height_ {0};
+
+        Texture_memory::Charge charge_;
+
+    public:
+        Render_target() = default;
+        // throws if the renderer can't render to textures, or blend premultiplied ones
+        Render_target(Renderer & renderer, int width, int height);
+        ~Render_target()
+        {
+            if(texture_)
+                SDL_DestroyTexture(texture_);
+        }
+
+        Render_target(const Render_target &) = delete;
+        Render_target &operator=(const Render_target &) = delete;
+
+        Render_target(Render_target && t):
+            texture_{t.texture_},
+            width_{t.width_},
+            height_{t.height_},
+            charge_{std::move(t.charge_)}
+        {
+            t.texture_ = nullptr;
+        }
+        Render_target &operator=(Render_target && t)
+        {
+            if(&t != this)
+            {
+                if(texture_)
+                    SDL_DestroyTexture(texture_);
+                texture_ = t.texture_;
+                t.texture_ = nullptr;
+                width_ = t.width_;
+                height_ = t.height_;
+                charge_ = std::move(t.charge_);
+            }
+            return *this;
+        }
+
+        operator bool const() { return texture_; }
+
+        int get_width() const { return width_; }
+        int get_height() const { return height_; }
+
+        void account(Texture_memory & memory, Texture_memory::Category category);
+
+        // replace the contents with batch drawn over transparency. Leaves the renderer drawing to the screen
+        void compose(Renderer & renderer, Batch & batch);
+
+        void render(Batch & batch, SDL_Color color, int x, int y);
     };
 }
 #endif // TEXTURE_HPP
@@ -0,0 +1,54 @@
+#include "texture_memory.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+    constexpr const char * category_names[Texture_memory::num_categories] = {"thumbnail", "text", "icon", "row", "atlas"};
+
+    struct KiB
+    {
+        std::size_t bytes;
+    };
+    std::ostream & operator<<(std::ostream & os, KiB k)
+    {
+        return os<<(k.bytes + 1023) / 1024<<" KiB";
+    }
+}
+
+void Texture_memory::Charge::release()
+{
+    if(!memory_)
+        return;
+
+    memory_->used_ -= bytes_;
+    memory_->used_by_[static_cast<int>(category_)] -= bytes_;
+    memory_ = nullptr;
+}
+
+Texture_memory::Charge Texture_memory::charge(Category category, std::size_t bytes)
+{
+    auto c = static_cast<int>(category);
+
+    used_ += bytes;
+    used_by_[c] += bytes;
+
+    peak_ = std::max(peak_, used_);
+    peak_by_[c] = std::max(peak_by_[c], used_by_[c]);
+
+    return Charge{this, category, bytes};
+}
+
+void Texture_memory::report(std::ostream & os) const
+{
+    os<<"Texture memory:\n";
+    for(auto i = 0; i < num_categories; ++i)
+        os<<"  "<<std::left<<std::setw(10)<<category_names[i]<<std::right<<KiB{used_by_[i]}<<" (peak "<<KiB{peak_by_[i]}<<")\n";
+
+    os<<"  total     "<<KiB{used_}<<" (peak "<<KiB{peak_}<<")";
+    if(budget_ > 0)
+        os<<", budget "<<KiB{budget_};
+    os<<'\n';
+    os.flush();
+}
@@ -0,0 +1,81 @@
+#ifndef TEXTURE_MEMORY_HPP
+#define TEXTURE_MEMORY_HPP
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+
+// Tracks how many bytes of pixel data textures hold, by category, against an optional budget.
+// Textures hold a Charge for their current size, which is released when they are destroyed or replaced. Atlas pages are
+// charged on their own, on top of the images packed into them, which are also kept in memory
+class Texture_memory
+{
+public:
+    enum class Category {THUMBNAIL, TEXT, ICON, ROW, ATLAS};
+    static constexpr auto num_categories = 5;
+
+    class Charge
+    {
+    public:
+        Charge() = default;
+        ~Charge() { release(); }
+
+        Charge(const Charge &) = delete;
+        Charge &operator=(const Charge &) = delete;
+
+        Charge(Charge && c): memory_{c.memory_}, category_{c.category_}, bytes_{c.bytes_}
+        {
+            c.memory_ = nullptr;
+        }
+        Charge &operator=(Charge && c)
+        {
+            if(&c != this)
+            {
+                release();
+                memory_ = c.memory_;
+                category_ = c.category_;
+                bytes_ = c.bytes_;
+                c.memory_ = nullptr;
+            }
+            return *this;
+        }
+
+        Texture_memory * get_memory() const { return memory_; }
+        Category get_category() const { return category_; }
+
+    private:
+        friend class Texture_memory;
+        Charge(Texture_memory * memory, Category category, std::size_t bytes):
+            memory_{memory}, category_{category}, bytes_{bytes}
+        {}
+
+        void release();
+
+        Texture_memory * memory_ {nullptr};
+        Category category_ {Category::THUMBNAIL};
+        std::size_t bytes_ {0};
+    };
+
+    // budget of 0 is unlimited
+    explicit Texture_memory(std::size_t budget = 0): budget_{budget} {}
+
+    Charge charge(Category category, std::size_t bytes);
+
+    std::size_t get_used() const { return used_; }
+    std::size_t get_used(Category category) const { return used_by_[static_cast<int>(category)]; }
+    std::size_t get_peak() const { return peak_; }
+    std::size_t get_budget() const { return budget_; }
+    bool over_budget() const { return budget_ > 0 && used_ > budget_; }
+
+    // per category usage and peaks, and the total against the budget
+    void report(std::ostream & os) const;
+
+private:
+    std::size_t budget_ {0};
+    std::size_t used_ {0};
+    std::size_t peak_ {0};
+    std::array<std::size_t, num_categories> used_by_ {};
+    std::array<std::size_t, num_categories> peak_by_ {};
+};
+
+#endif // TEXTURE_MEMORY_HPP